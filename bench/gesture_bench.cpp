@@ -0,0 +1,400 @@
+// Microbenchmarks for the input thread's hot path: swipe classification,
+// pinch accumulation, binding lookup, sequence matching, whole traces through GestureEngine
+// and the input thread, plus the GUI editor's derived-data rebuilds.
+//
+// Every benchmark reports time/event and allocs/event. Pass --trace FILE
+// (recorded with the daemon's --record) to also run the trace benchmarks on
+// real input; otherwise they use a synthetic trace.
+
+#include <benchmark/benchmark.h>
+
+#include <poll.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "src/alloc_counter.h"
+#include "src/binding_editor.h"
+#include "src/bindings.h"
+#include "src/executor.h"
+#include "src/gesture_engine.h"
+#include "src/input_thread.h"
+#include "src/log.h"
+#include "src/pinch_recognizer.h"
+#include "src/snapshot.h"
+#include "src/swipe_recognizer.h"
+#include "src/trace.h"
+
+// Samples per synthetic gesture, roughly a 150 ms swipe at 140 Hz
+static const int UPDATES_PER_GESTURE = 20;
+
+static void report(benchmark::State &state, uint64_t allocations, double events_per_iteration)
+{
+    double events = (double)state.iterations() * events_per_iteration;
+    state.SetItemsProcessed((int64_t)events);
+    state.counters["time/event"] = benchmark::Counter(events, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+    state.counters["allocs/event"] = events > 0 ? allocations / events : 0.0;
+}
+
+// 3 and 4 finger swipes, 2 finger pinches, 3 finger holds and scrolling,
+// as a typical config binds them
+static BindingTable make_table()
+{
+    BindingTable table;
+    for (int fingers = 3; fingers <= 4; ++fingers)
+    {
+        for (int dir = 0; dir < GESTURE_DIRECTION_COUNT; ++dir)
+            table[make_gesture_key(GestureKind::Swipe, fingers, dir)] = std::make_shared<Command>("true");
+    }
+    table[make_gesture_key(2, PinchDirection::In)] = std::make_shared<Command>("true");
+    table[make_gesture_key(2, PinchDirection::Out)] = std::make_shared<Command>("true");
+    table[make_gesture_key(3, HoldLength::Short)] = std::make_shared<Command>("true");
+    table[make_gesture_key(GestureKind::Scroll, 2, Direction::Down)] = std::make_shared<Command>("true");
+    return table;
+}
+
+// Random mix of complete gestures, 7 ms apart like touchpad frames
+static std::vector<TraceEvent> synthetic_trace(size_t gestures)
+{
+    // Millimetres per frame
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> motion(-0.8f, 0.8f);
+    std::vector<TraceEvent> events;
+    uint64_t t = 1000000;
+
+    auto add = [&](TraceEventType type, int fingers, float dx = 0, float dy = 0, float scale = 0) {
+        TraceEvent event = {};
+        event.time_us = t;
+        event.type = type;
+        event.fingers = (uint8_t)fingers;
+        event.dx = dx;
+        event.dy = dy;
+        event.scale = scale;
+        events.push_back(event);
+        t += 7000;
+    };
+
+    for (size_t g = 0; g < gestures; ++g)
+    {
+        switch (g % 4)
+        {
+            case 0:
+            {
+                int fingers = 3 + (int)(rng() % 2);
+                float bias_x = motion(rng), bias_y = motion(rng);
+                add(TraceEventType::SwipeBegin, fingers);
+                for (int i = 0; i < UPDATES_PER_GESTURE; ++i)
+                    add(TraceEventType::SwipeUpdate, fingers, bias_x + motion(rng) / 4, bias_y + motion(rng) / 4);
+                add(TraceEventType::SwipeEnd, fingers);
+                break;
+            }
+            case 1:
+            {
+                float rate = (rng() % 2 ? 0.02f : -0.01f);
+                add(TraceEventType::PinchBegin, 2, 0, 0, 1.0f);
+                for (int i = 1; i <= UPDATES_PER_GESTURE; ++i)
+                    add(TraceEventType::PinchUpdate, 2, motion(rng) / 8, motion(rng) / 8, 1.0f + rate * i);
+                add(TraceEventType::PinchEnd, 2);
+                break;
+            }
+            case 2:
+                add(TraceEventType::HoldBegin, 3);
+                t += 400000;
+                add(TraceEventType::HoldEnd, 3);
+                break;
+            case 3:
+            {
+                for (int i = 0; i <= UPDATES_PER_GESTURE; ++i)
+                {
+                    add(TraceEventType::Scroll, 0, 0, i < UPDATES_PER_GESTURE ? 0.5f + motion(rng) / 4 : 0.0f);
+                    events.back().flags = TRACE_SCROLL_FINGER | TRACE_SCROLL_V;
+                }
+                break;
+            }
+        }
+    }
+    return events;
+}
+
+static std::vector<TraceEvent> recorded_trace;
+
+static const std::vector<TraceEvent> &bench_trace()
+{
+    static const std::vector<TraceEvent> synthetic = synthetic_trace(4000);
+    return recorded_trace.empty() ? synthetic : recorded_trace;
+}
+
+static void BM_ClassifySwipe(benchmark::State &state)
+{
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> motion(-10.0, 10.0);
+    std::vector<std::pair<double, double>> samples(4096);
+    for (auto &sample : samples)
+        sample = {motion(rng), motion(rng)};
+
+    uint64_t allocations = thread_allocation_count();
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        Direction dir;
+        const auto &sample = samples[i++ & (samples.size() - 1)];
+        bool classified = classify_swipe(sample.first, sample.second, SWIPE_THRESHOLD_MM, dir);
+        benchmark::DoNotOptimize(classified);
+        benchmark::DoNotOptimize(dir);
+    }
+    report(state, thread_allocation_count() - allocations, 1);
+}
+BENCHMARK(BM_ClassifySwipe);
+
+static void BM_SwipeUpdate(benchmark::State &state)
+{
+    BindingTable table = make_table();
+    SwipeRecognizer swipe;
+    GestureKey key;
+
+    uint64_t allocations = thread_allocation_count();
+    for (auto _ : state)
+    {
+        swipe.begin(3);
+        for (int i = 0; i < UPDATES_PER_GESTURE; ++i)
+            benchmark::DoNotOptimize(swipe.update(0.4, 0.05, table, key));
+        benchmark::DoNotOptimize(swipe.end(false, table, key));
+    }
+    report(state, thread_allocation_count() - allocations, UPDATES_PER_GESTURE + 2);
+}
+BENCHMARK(BM_SwipeUpdate);
+
+static void BM_PinchUpdate(benchmark::State &state)
+{
+    BindingTable table = make_table();
+    PinchRecognizer pinch;
+    GestureKey key;
+
+    uint64_t allocations = thread_allocation_count();
+    for (auto _ : state)
+    {
+        pinch.begin(2);
+        for (int i = 1; i <= UPDATES_PER_GESTURE; ++i)
+            pinch.update(1.0 + 0.01 * i, 0.1, -0.1, table);
+        benchmark::DoNotOptimize(pinch.end(false, key));
+    }
+    report(state, thread_allocation_count() - allocations, UPDATES_PER_GESTURE + 2);
+}
+BENCHMARK(BM_PinchUpdate);
+
+// What dispatch() does before handing off: RCU read plus one slot load
+static void BM_BindingLookup(benchmark::State &state)
+{
+    Snapshot<BindingTable> bindings(std::make_unique<BindingTable>(make_table()));
+    std::mt19937 rng(1);
+    std::vector<GestureKey> keys(4096);
+    for (GestureKey &key : keys)
+        key = (GestureKey)(rng() % GESTURE_KEY_COUNT);
+
+    uint64_t allocations = thread_allocation_count();
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        const CommandRef &command = (*bindings.read())[keys[i++ & (keys.size() - 1)]];
+        benchmark::DoNotOptimize(command.get());
+    }
+    report(state, thread_allocation_count() - allocations, 1);
+}
+BENCHMARK(BM_BindingLookup);
+
+// One recognised gesture through the sequence matcher, with range(0)
+// random 2-4 gesture sequences over 3 and 4 finger swipes; should not
+// depend on how many there are
+static void BM_SequenceFeed(benchmark::State &state)
+{
+    std::mt19937 rng(1);
+    auto random_swipe = [&] {
+        return make_gesture_key(GestureKind::Swipe, 3 + (int)(rng() % 2), (int)(rng() % GESTURE_DIRECTION_COUNT));
+    };
+
+    BindingTable table;
+    for (int64_t i = 0; i < state.range(0); ++i)
+    {
+        SequenceBinding sequence;
+        size_t length = 2 + rng() % 3;
+        for (size_t k = 0; k < length; ++k)
+            sequence.keys.push_back(random_swipe());
+        sequence.command = std::make_shared<Command>("true");
+        set_sequence(table.sequences, std::move(sequence));
+    }
+    table.compile_sequences();
+
+    std::vector<GestureKey> keys(4096);
+    for (GestureKey &key : keys)
+        key = random_swipe();
+
+    SequenceState sequence_state;
+    uint64_t allocations = thread_allocation_count();
+    uint64_t t = 0;
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        t += 200000;
+        benchmark::DoNotOptimize(table.matcher->feed(sequence_state, keys[i++ & (keys.size() - 1)], t));
+    }
+    report(state, thread_allocation_count() - allocations, 1);
+    state.counters["states"] = (double)table.matcher->state_count();
+}
+BENCHMARK(BM_SequenceFeed)->Arg(1)->Arg(100)->Arg(1000);
+
+// The engine alone: every recognizer, with nothing done about the result
+static void BM_EngineTrace(benchmark::State &state)
+{
+    const std::vector<TraceEvent> &events = bench_trace();
+    BindingTable table = make_table();
+    auto engine = std::make_unique<GestureEngine>();
+    GestureEngine::Output recognized;
+
+    uint64_t allocations = thread_allocation_count();
+    for (auto _ : state)
+    {
+        size_t gestures = 0;
+        for (const TraceEvent &event : events)
+            gestures += engine->feed(event, table, recognized);
+        benchmark::DoNotOptimize(gestures);
+    }
+    report(state, thread_allocation_count() - allocations, (double)events.size());
+}
+BENCHMARK(BM_EngineTrace)->Unit(benchmark::kMicrosecond);
+
+// As above, with updates merged the way InputThread merges them within a
+// libinput_dispatch batch of range(0) events
+static void BM_EngineTraceCoalesced(benchmark::State &state)
+{
+    const std::vector<TraceEvent> &events = bench_trace();
+    size_t batch = (size_t)state.range(0);
+    BindingTable table = make_table();
+    auto engine = std::make_unique<GestureEngine>();
+    GestureEngine::Output recognized;
+
+    uint64_t allocations = thread_allocation_count();
+    for (auto _ : state)
+    {
+        size_t gestures = 0;
+        for (size_t start = 0; start < events.size(); start += batch)
+        {
+            size_t end = std::min(events.size(), start + batch);
+            TraceEvent pending = events[start];
+            for (size_t i = start + 1; i < end; ++i)
+            {
+                if (coalesce_update(pending, events[i]))
+                    continue;
+                gestures += engine->feed(pending, table, recognized);
+                pending = events[i];
+            }
+            gestures += engine->feed(pending, table, recognized);
+        }
+        benchmark::DoNotOptimize(gestures);
+    }
+    report(state, thread_allocation_count() - allocations, (double)events.size());
+}
+BENCHMARK(BM_EngineTraceCoalesced)->Arg(1)->Arg(4)->Arg(16)->Unit(benchmark::kMicrosecond);
+
+// The whole input thread replaying the trace with --fast --dry-run. Runs on
+// another thread, so allocations are not counted; logging is turned down so
+// the "Detected" lines are skipped rather than formatted.
+static void BM_ReplayTrace(benchmark::State &state)
+{
+    const std::vector<TraceEvent> &events = bench_trace();
+    Snapshot<BindingTable> bindings(std::make_unique<BindingTable>(make_table()));
+    Executor executor;
+
+    LogLevel saved_level = log_level();
+    set_log_level(LogLevel::Error);
+    for (auto _ : state)
+    {
+        InputThread input(nullptr, bindings, executor);
+        input.set_replay(&events, true);
+        input.set_dry_run(true);
+        if (!input.start())
+        {
+            state.SkipWithError("failed to start input thread");
+            break;
+        }
+        struct pollfd done = {input.exit_fd(), POLLIN, 0};
+        poll(&done, 1, -1);
+        input.stop();
+    }
+    set_log_level(saved_level);
+    report(state, 0, (double)events.size());
+}
+BENCHMARK(BM_ReplayTrace)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static BindingConfig make_editor_config(int user_commands)
+{
+    BindingConfig config;
+    config.bindings = make_table();
+    for (int i = 0; i < user_commands; ++i)
+        config.user_commands.push_back("command-" + std::to_string(i));
+    return config;
+}
+
+// Binding a row marks the selection dirty; rows() then re-syncs every row
+// (sync_selected_commands)
+static void BM_EditorSync(benchmark::State &state)
+{
+    BindingEditor editor(make_editor_config((int)state.range(0)));
+    size_t rows = editor.rows().size();
+
+    uint64_t allocations = thread_allocation_count();
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        editor.bind(i++ % rows, 0);
+        benchmark::DoNotOptimize(editor.rows().data());
+    }
+    report(state, thread_allocation_count() - allocations, 1);
+}
+BENCHMARK(BM_EditorSync)->Arg(0)->Arg(100)->Arg(1000);
+
+// A fresh editor rebuilds the command list and index and prunes every slot
+// against it, as after loading a config or adding a command
+static void BM_EditorRebuild(benchmark::State &state)
+{
+    BindingConfig config = make_editor_config((int)state.range(0));
+
+    uint64_t allocations = thread_allocation_count();
+    for (auto _ : state)
+    {
+        BindingEditor editor(config);
+        benchmark::DoNotOptimize(editor.commands().data());
+    }
+    report(state, thread_allocation_count() - allocations, 1);
+}
+BENCHMARK(BM_EditorRebuild)->Arg(0)->Arg(100)->Arg(1000);
+
+int main(int argc, char **argv)
+{
+    // Our own flag first; benchmark::Initialize rejects unknown ones
+    int out = 1;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+        {
+            if (!load_trace(argv[++i], recorded_trace))
+                return 1;
+        }
+        else
+        {
+            argv[out++] = argv[i];
+        }
+    }
+    argc = out;
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
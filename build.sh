@@ -1,28 +1,34 @@
-#!/bin/bash
-
-# Default to release if no argument is provided
-BUILD_TYPE="Release"
-DEVICE_PATH="/dev/input/event5"
-
-# Convert input to lowercase
-INPUT_TYPE=$(echo "$1" | tr '[:upper:]' '[:lower:]')
-
-if [[ "$INPUT_TYPE" == "debug" ]]; then
-    BUILD_TYPE="Debug"
-fi
-
-echo "Building in $BUILD_TYPE mode..."
-
-# Create build directory if not present
-mkdir -p build
-cd build || exit 1
-
-# Configure with CMake
-cmake -DCMAKE_BUILD_TYPE=$BUILD_TYPE ..
-
-# Build the project
-make -j$(nproc)
-
-# Run the binary
-echo "Running gesture_daemon on $DEVICE_PATH"
-./gesture_daemon "$DEVICE_PATH"
+#!/bin/bash
+
+# Default to release if no argument is provided
+BUILD_TYPE="Release"
+# Leave empty to pick up every device on the udev seat, including hotplugged ones
+DEVICE_PATH="${DEVICE_PATH:-}"
+
+# Convert input to lowercase
+INPUT_TYPE=$(echo "$1" | tr '[:upper:]' '[:lower:]')
+
+if [[ "$INPUT_TYPE" == "debug" ]]; then
+    BUILD_TYPE="Debug"
+fi
+
+echo "Building in $BUILD_TYPE mode..."
+
+# Create build directory if not present
+mkdir -p build
+cd build || exit 1
+
+# Configure with CMake
+cmake -DCMAKE_BUILD_TYPE=$BUILD_TYPE ..
+
+# Build the project
+make -j$(nproc)
+
+# Run the binary
+if [[ -n "$DEVICE_PATH" ]]; then
+    echo "Running gesture_daemon on $DEVICE_PATH"
+    ./gesture_daemon "$DEVICE_PATH"
+else
+    echo "Running gesture_daemon on seat0"
+    ./gesture_daemon
+fi
@@ -1,470 +1,426 @@
-#include <libinput.h>
-#include <fcntl.h>
-#include <unistd.h>
-#include <poll.h>
-#include <iostream>
-#include <string>
-#include <map>
-#include <vector>
-#include <algorithm>
-
-// GLFW and ImGui includes
-#include <GLFW/glfw3.h>
-#include "imgui/imgui.h"
-#include "imgui/backends/imgui_impl_glfw.h"
-#include "imgui/backends/imgui_impl_opengl3.h"
-
-// libinput_interface implementation
-static int open_restricted(const char *path, int flags, void *user_data)
-{
-    int fd = open(path, flags);
-    if (fd < 0)
-        std::cerr << "Failed to open: " << path << std::endl;
-    return fd;
-}
-
-static void close_restricted(int fd, void *user_data)
-{
-    close(fd);
-}
-
-static const struct libinput_interface interface = {
-    .open_restricted = open_restricted,
-    .close_restricted = close_restricted,
-};
-
-// Human-readable event type mapping
-std::string get_event_type_name(enum libinput_event_type type)
-{
-    switch (type)
-    {
-    case LIBINPUT_EVENT_DEVICE_ADDED:
-        return "DEVICE_ADDED";                      // device connect
-    case LIBINPUT_EVENT_DEVICE_REMOVED:
-        return "DEVICE_REMOVED";                    // device remove
-
-    case LIBINPUT_EVENT_POINTER_MOTION:
-        return "POINTER_MOTION";                    // 1 finger scroll
-    case LIBINPUT_EVENT_POINTER_BUTTON:
-        return "POINTER_BUTTON";                    // buttons
-
-    case LIBINPUT_EVENT_POINTER_AXIS:
-        return "POINTER_AXIS";                      // 2 finger scroll
-    case LIBINPUT_EVENT_POINTER_SCROLL_FINGER:
-        return "POINTER_FINGER";                    // 2 finger scroll
-        
-    case LIBINPUT_EVENT_GESTURE_SWIPE_BEGIN:
-        return "GESTURE_SWIPE_BEGIN";               // 3,4 finger scroll
-    case LIBINPUT_EVENT_GESTURE_SWIPE_UPDATE:
-        return "GESTURE_SWIPE_UPDATE";
-    case LIBINPUT_EVENT_GESTURE_SWIPE_END:
-        return "GESTURE_SWIPE_END";
-
-    case LIBINPUT_EVENT_GESTURE_PINCH_BEGIN:
-        return "GESTURE_PINCH_BEGIN";               // 2,3,4 finger zoom
-    case LIBINPUT_EVENT_GESTURE_PINCH_UPDATE:
-        return "GESTURE_PINCH_UPDATE";
-    case LIBINPUT_EVENT_GESTURE_PINCH_END:
-        return "GESTURE_PINCH_END";
-
-    case LIBINPUT_EVENT_GESTURE_HOLD_BEGIN:
-        return "GESTURE_HOLD_BEGIN";               // 1,2 finger tap
-    case LIBINPUT_EVENT_GESTURE_HOLD_END:
-        return "GESTURE_HOLD_END";
-
-    default:
-        return "UNKNOWN_EVENT_" + std::to_string(type);
-    }
-}
-
-struct SwipeGesture {
-    double dx = 0.0;
-    double dy = 0.0;
-    bool active = false;
-    int fingers = 0;
-};
-
-struct PinchGesture {
-    double scale = 1.0;
-    double dx = 0.0;
-    double dy = 0.0;
-    int fingers = 0;
-    bool active = false;
-};
-
-
-SwipeGesture swipe;
-PinchGesture pinch;
-
-std::map<std::pair<int, std::string>, std::string> gesture_bindings;
-static std::map<std::pair<int, std::string>, int> selected_command_indices;
-
-void sync_selected_commands(const std::vector<std::string>& commands) {
-    for (const auto& [key, cmd] : gesture_bindings) {
-        auto it = std::find(commands.begin(), commands.end(), cmd);
-        if (it != commands.end()) {
-            selected_command_indices[key] = std::distance(commands.begin(), it);
-        }
-    }
-}
-
-int main(int argc, char **argv)
-{
-    if (argc != 2)
-    {
-        std::cerr << "Usage: " << argv[0] << " /dev/input/eventX\n";
-        return 1;
-    }
-
-    const char *device_path = argv[1];
-    struct libinput *li = libinput_path_create_context(&interface, nullptr);
-    if (!li)
-    {
-        std::cerr << "Failed to create libinput context\n";
-        return 1;
-    }
-
-    struct libinput_device *device = libinput_path_add_device(li, device_path);
-    if (!device)
-    {
-        std::cerr << "Failed to add device: " << device_path << "\n";
-        libinput_unref(li);
-        return 1;
-    }
-
-    std::cout << "Listening for events on: " << device_path << "\n";
-
-    // Initialize GLFW
-    if (!glfwInit())
-    {
-        std::cerr << "Failed to initialize GLFW\n";
-        return 1;
-    }
-
-    // Setup OpenGL version (3.3 core)
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-    GLFWwindow *window = glfwCreateWindow(800, 600, "Touchpad Gesture Daemon", NULL, NULL);
-    if (!window)
-    {
-        std::cerr << "Failed to create GLFW window\n";
-        glfwTerminate();
-        return 1;
-    }
-
-    glfwMakeContextCurrent(window);
-    glfwSwapInterval(1); // Enable vsync
-
-    // Setup ImGui context
-    IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
-    ImGuiIO &io = ImGui::GetIO();
-    (void)io;
-
-    // Setup ImGui style
-    ImGui::StyleColorsDark();
-
-    // Setup Platform/Renderer backends
-    ImGui_ImplGlfw_InitForOpenGL(window, true);
-    ImGui_ImplOpenGL3_Init("#version 330");
-
-    int fd = libinput_get_fd(li);
-    struct pollfd fds = {fd, POLLIN, 0};
-
-    while (!glfwWindowShouldClose(window))
-    {
-        // Poll for libinput events without blocking the UI thread
-        if (poll(&fds, 1, 0) > 0)
-        {
-            if (libinput_dispatch(li) != 0)
-            {
-                std::cerr << "libinput_dispatch failed\n";
-                break;
-            }
-
-            struct libinput_event *event;
-            while ((event = libinput_get_event(li)) != NULL)
-            {
-                libinput_event_type type = libinput_event_get_type(event);
-                std::string type_str = get_event_type_name(type);
-
-                switch (type)
-                {
-                    case LIBINPUT_EVENT_GESTURE_SWIPE_BEGIN:
-                    {
-                        swipe.active = true;
-                        swipe.dx = 0.0;
-                        swipe.dy = 0.0;
-                        struct libinput_event_gesture *gesture_event = libinput_event_get_gesture_event(event);
-                        swipe.fingers = libinput_event_gesture_get_finger_count(gesture_event);
-                        #ifdef DEBUG
-                        std::cout << "Swipe gesture started with " << swipe.fingers << " fingers\n";
-                        #endif
-                        break;
-                    }
-
-                    case LIBINPUT_EVENT_GESTURE_SWIPE_UPDATE:
-                    {
-                        struct libinput_event_gesture *gesture_event = libinput_event_get_gesture_event(event);
-                        swipe.dx += libinput_event_gesture_get_dx(gesture_event);
-                        swipe.dy += libinput_event_gesture_get_dy(gesture_event);
-                        #ifdef DEBUG
-                        std::cout << "Swipe update: dx=" << swipe.dx << ", dy=" << swipe.dy << "\n";
-                        #endif
-                        break;
-                    }
-
-                    case LIBINPUT_EVENT_GESTURE_SWIPE_END:
-                    {
-                        swipe.active = false;
-                        #ifdef DEBUG
-                        std::cout << "Swipe gesture (" << swipe.fingers << " fingers) ended with dx=" << swipe.dx << ", dy=" << swipe.dy << "\n";
-                        #endif
-
-                        std::string direction;
-                        if (std::abs(swipe.dx) > std::abs(swipe.dy)) {
-                            if (swipe.dx > 50)
-                                direction = "RIGHT";
-                            else if (swipe.dx < -50)
-                                direction = "LEFT";
-                        } else {
-                            if (swipe.dy > 50)
-                                direction = "DOWN";
-                            else if (swipe.dy < -50)
-                                direction = "UP";
-                        }
-
-                        if (!direction.empty()) {
-                            std::cout << "Detected " << swipe.fingers << "-finger swipe " << direction << std::endl;
-
-                            auto it = gesture_bindings.find({swipe.fingers, direction});
-                            if (it != gesture_bindings.end()) {
-                                std::cout << "Running command: " << it->second << std::endl;
-                                int ret = std::system(it->second.c_str());
-                                (void)ret;
-                            } else {
-                                std::cout << "No binding found for this gesture\n";
-                            }
-                        }
-
-                        break;
-                    }
-
-
-                    case LIBINPUT_EVENT_POINTER_AXIS:
-                    {
-                        struct libinput_event_pointer *pointer_event = libinput_event_get_pointer_event(event);
-
-                        if (libinput_event_pointer_has_axis(pointer_event, LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL)) {
-                            double v_scroll = libinput_event_pointer_get_axis_value(pointer_event, LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL);
-                            #ifdef DEBUG
-                            std::cout << "2-finger vertical scroll: " << v_scroll << std::endl;
-                            #endif
-                        }
-
-                        if (libinput_event_pointer_has_axis(pointer_event, LIBINPUT_POINTER_AXIS_SCROLL_HORIZONTAL)) {
-                            double h_scroll = libinput_event_pointer_get_axis_value(pointer_event, LIBINPUT_POINTER_AXIS_SCROLL_HORIZONTAL);
-                            #ifdef DEBUG
-                            std::cout << "2-finger horizontal scroll: " << h_scroll << std::endl;
-                            #endif
-                        }
-
-                        break;
-                    }
-
-                    case LIBINPUT_EVENT_GESTURE_PINCH_BEGIN:
-                    {
-                        pinch.active = true;
-                        pinch.scale = 1.0;
-                        pinch.dx = 0.0;
-                        pinch.dy = 0.0;
-                        struct libinput_event_gesture *gesture_event = libinput_event_get_gesture_event(event);
-                        pinch.fingers = libinput_event_gesture_get_finger_count(gesture_event);
-                        #ifdef DEBUG
-                        std::cout << "Pinch gesture started with " << pinch.fingers << " fingers\n";
-                        #endif
-                        break;
-                    }
-
-                    case LIBINPUT_EVENT_GESTURE_PINCH_UPDATE:
-                    {
-                        struct libinput_event_gesture *gesture_event = libinput_event_get_gesture_event(event);
-                        double scale_step = libinput_event_gesture_get_scale(gesture_event);
-                        pinch.scale *= scale_step;
-
-                        pinch.dx += libinput_event_gesture_get_dx(gesture_event);
-                        pinch.dy += libinput_event_gesture_get_dy(gesture_event);
-                        #ifdef DEBUG
-                        std::cout << "Pinch update: scale=" << pinch.scale << ", dx=" << pinch.dx << ", dy=" << pinch.dy << std::endl;
-                        #endif
-                        break;
-                    }
-
-                    case LIBINPUT_EVENT_GESTURE_PINCH_END:
-                    {
-                        pinch.active = false;
-                        #ifdef DEBUG
-                        std::cout << "Pinch gesture ended with total scale=" << pinch.scale
-                                << ", dx=" << pinch.dx << ", dy=" << pinch.dy << "\n";
-                        #endif
-
-                        if (pinch.scale > 1.1)
-                            std::cout << "Detected pinch out (zoom in)\n";
-                        else if (pinch.scale < 0.9)
-                            std::cout << "Detected pinch in (zoom out)\n";
-                        else
-                            std::cout << "Minor pinch, no zoom direction detected\n";
-
-                        break;
-                    }
-
-                    case LIBINPUT_EVENT_GESTURE_HOLD_BEGIN:
-                    {
-                        struct libinput_event_gesture *gesture_event = libinput_event_get_gesture_event(event);
-                        int fingers = libinput_event_gesture_get_finger_count(gesture_event);
-                        #ifdef DEBUG
-                        std::cout << "Hold gesture started with " << fingers << " finger(s)" << std::endl;
-                        #endif
-                        break;
-                    }
-                    case LIBINPUT_EVENT_GESTURE_HOLD_END:
-                    {
-                        struct libinput_event_gesture *gesture_event = libinput_event_get_gesture_event(event);
-                        int fingers = libinput_event_gesture_get_finger_count(gesture_event);
-                        #ifdef DEBUG
-                        std::cout << "Hold gesture ended with " << fingers << " finger(s)" << std::endl;
-                        #endif
-                        break;
-                    }
-
-                    default:
-                        // For all other events, just print their type
-                        #ifdef DEBUG
-                        std::cout << "Event: " << type_str << std::endl;
-                        #endif
-                        break;
-                }
-
-                libinput_event_destroy(event);
-            }
-
-        }
-
-        // Poll and handle GLFW events
-        glfwPollEvents();
-
-        // Start ImGui frame
-        ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
-        ImGui::SetNextWindowPos(ImVec2(100, 100), ImGuiCond_FirstUseEver);
-        ImGui::SetNextWindowSize(ImVec2(600, 350), ImGuiCond_FirstUseEver);
-        
-        ImGui::Begin("Gesture Bindings");
-
-        //Custom‐command buffer
-        static std::vector<std::string> user_commands;
-        static char custom_cmd[256] = "";
-        ImGui::InputText("Custom Command", custom_cmd, IM_ARRAYSIZE(custom_cmd));
-        ImGui::SameLine();
-        if (ImGui::Button("Add")) {
-            std::string cmd = std::string(custom_cmd);
-            if (!cmd.empty() &&
-                std::find(user_commands.begin(), user_commands.end(), cmd) == user_commands.end())
-            {
-                user_commands.push_back(cmd);
-            }
-            custom_cmd[0] = '\0'; // clear input
-        }
-        ImGui::Separator();
-
-        // Default options
-        const std::vector<std::string> predefined_commands = {
-            "None",
-            "notify-send 'Gesture Triggered'",
-            // Launch terminal
-            "gnome-terminal",
-            // Launch Google Chrome
-            "google-chrome",
-            // Media controls
-            "playerctl play-pause",
-            "playerctl next",
-            "playerctl previous"
-        };
-
-        std::vector<std::string> all_commands = predefined_commands;
-        all_commands.insert(all_commands.end(), user_commands.begin(), user_commands.end());
-
-        // Prune stale bindings and re-sync
-        for (auto it = gesture_bindings.begin(); it != gesture_bindings.end(); ) {
-            if (std::find(all_commands.begin(), all_commands.end(), it->second) == all_commands.end()) {
-                it = gesture_bindings.erase(it);
-            } else {
-                ++it;
-            }
-        }
-        selected_command_indices.clear();
-        sync_selected_commands(all_commands);
-
-
-        // Display
-        const std::vector<std::string> directions = {"LEFT", "RIGHT", "UP", "DOWN"};
-
-        for (int fingers : {3, 4}) {
-            for (const std::string& dir : directions) {
-                auto key = std::make_pair(fingers, dir);
-                std::string label = std::to_string(fingers) + "F " + dir;
-
-                int& selected = selected_command_indices[key]; // persists across frames
-
-                if (ImGui::BeginCombo(label.c_str(), all_commands[selected].c_str())) {
-                    for (int i = 0; i < (int)all_commands.size(); ++i) {
-                        bool is_selected = (selected == i);
-                        if (ImGui::Selectable(all_commands[i].c_str(), is_selected)) {
-                            selected = i;
-
-                            if (all_commands[i] == "None") {
-                                gesture_bindings.erase(key);
-                                std::cout << "Unbound " << fingers << "F " << dir << std::endl;
-                            } else {
-                                gesture_bindings[key] = all_commands[i];
-                                std::cout << "Bound " << fingers << "F " << dir
-                                        << " -> " << all_commands[i] << std::endl;
-                            }
-                        }
-                        if (is_selected)
-                            ImGui::SetItemDefaultFocus();
-                    }
-                    ImGui::EndCombo();
-                }
-            }
-        }
-
-        ImGui::End();
-
-
-        // Rendering
-        ImGui::Render();
-        int display_w, display_h;
-        glfwGetFramebufferSize(window, &display_w, &display_h);
-        glViewport(0, 0, display_w, display_h);
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-
-        glfwSwapBuffers(window);
-    }
-
-    // Cleanup
-    ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
-    ImGui::DestroyContext();
-
-    glfwDestroyWindow(window);
-    glfwTerminate();
-
-    libinput_unref(li);
-    return 0;
-}
\ No newline at end of file
+#include <libinput.h>
+#include <libudev.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <memory>
+#include <vector>
+
+#include "src/active_window.h"
+#include "src/binding_store.h"
+#include "src/bindings.h"
+#include "src/config.h"
+#include "src/config_watcher.h"
+#include "src/control_server.h"
+#include "src/executor.h"
+#include "src/input_thread.h"
+#include "src/reactor.h"
+#include "src/log.h"
+#include "src/metrics_server.h"
+#include "src/snapshot.h"
+#include "src/stats.h"
+#include "src/thread_priority.h"
+#include "src/trace.h"
+
+#ifdef WITH_GUI
+#include "src/gui.h"
+#endif
+
+// libinput_interface implementation
+static int open_restricted(const char *path, int flags, void *user_data)
+{
+    int fd = open(path, flags);
+    if (fd < 0)
+        LOG(Error) << "Failed to open: " << path;
+    return fd;
+}
+
+static void close_restricted(int fd, void *user_data)
+{
+    close(fd);
+}
+
+static const struct libinput_interface interface = {
+    .open_restricted = open_restricted,
+    .close_restricted = close_restricted,
+};
+
+static void usage(const char *argv0)
+{
+#ifdef WITH_GUI
+    std::cerr << "Usage: " << argv0 << " [--headless] [--store FILE] [--config FILE] [--seat SEAT] [/dev/input/eventX...]\n";
+#else
+    std::cerr << "Usage: " << argv0 << " [--store FILE] [--config FILE] [--seat SEAT] [/dev/input/eventX...]\n";
+#endif
+    std::cerr << "       " << argv0 << " ... [--record TRACE] | [--replay TRACE [--fast]] [--dry-run]\n";
+    std::cerr << "Without device paths, all devices on the udev seat (default seat0) are used.\n";
+#ifdef WITH_GUI
+    std::cerr << "--headless starts without the window; the control socket's gui command opens it.\n"
+                 "Closing the window frees it and leaves gesture handling running.\n";
+#endif
+    std::cerr << "--record saves the events handled to TRACE; --replay feeds them back instead of\n"
+                 "reading devices, at the recorded pace or with --fast as quickly as possible.\n"
+                 "--dry-run recognises gestures without running their commands.\n";
+    std::cerr << "--log-level error|warn|info|debug|trace sets how much is logged (default info).\n";
+    std::cerr << "--control PATH listens for control commands on PATH instead of\n"
+                 "$XDG_RUNTIME_DIR/gesture-daemon.sock; --no-control disables the socket.\n";
+    std::cerr << "--metrics-port PORT serves OpenMetrics counters at http://127.0.0.1:PORT/metrics.\n";
+    std::cerr << "--realtime PRIO runs the input thread SCHED_FIFO at PRIO (1-99), or --nice N at\n"
+                 "nice N (-20-19), asking rtkit if not permitted; --cpu N pins it to CPU N;\n"
+                 "--mlock locks the daemon's memory so it can't be paged out.\n";
+}
+
+// Whole decimal number within [min, max]
+static bool parse_int(const char *text, int min, int max, int &out)
+{
+    char *end;
+    errno = 0;
+    long value = std::strtol(text, &end, 10);
+    if (errno != 0 || end == text || *end != '\0' || value < min || value > max)
+        return false;
+    out = (int)value;
+    return true;
+}
+
+// Sleep until SIGINT/SIGTERM or until the input thread gives up; SIGUSR1
+// dumps the latency histograms. The signals must already be blocked in
+// every thread.
+//
+// show_gui, if given, runs the window until it is closed, running this loop
+// on another thread meanwhile; it is called at once if open_gui is set and again
+// whenever gui_fd is written to while the window is closed.
+static int run_daemon(InputThread &input, const sigset_t &signals, int gui_fd, bool open_gui,
+                      const std::function<void(Reactor &)> &show_gui)
+{
+    Reactor reactor;
+    if (!reactor.open())
+        return 1;
+
+    bool watching = reactor.add_signals(signals, [&reactor](int signo) {
+        if (signo == SIGUSR1)
+            dump_pipeline_stats(std::cout);
+        else
+            reactor.stop();
+    });
+    if (!watching || !reactor.add(input.exit_fd(), EPOLLIN, [&reactor](uint32_t) { reactor.stop(); }))
+        return 1;
+
+    bool showing = false;
+    if (gui_fd >= 0)
+    {
+        bool added = reactor.add(gui_fd, EPOLLIN, [gui_fd, &showing, &open_gui](uint32_t) {
+            uint64_t count;
+            ssize_t ret = read(gui_fd, &count, sizeof(count));
+            (void)ret;
+            if (!showing)
+                open_gui = true;
+        });
+        if (!added)
+            return 1;
+    }
+
+    while (!reactor.stopping())
+    {
+        if (open_gui && show_gui)
+        {
+            open_gui = false;
+            showing = true;
+            show_gui(reactor);
+            showing = false;
+            continue;
+        }
+        if (!reactor.run_once())
+        {
+            LOG(Error) << "epoll_wait failed: " << std::strerror(errno);
+            return 1;
+        }
+    }
+    dump_pipeline_stats(std::cout);
+    return input.failed() ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    bool headless = false;
+    std::string store_path = default_store_path();
+    std::string config_path;
+    const char *seat = "seat0";
+    std::vector<const char *> device_paths;
+    std::string record_path;
+    std::string replay_path;
+    bool fast = false;
+    bool dry_run = false;
+    LogLevel level = log_level();
+    std::string control_path = default_control_path();
+    bool control_given = false;
+    SchedulingOptions scheduling;
+    int metrics_port = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--headless")
+            headless = true;
+        else if (arg == "--store" && i + 1 < argc)
+            store_path = argv[++i];
+        else if (arg == "--config" && i + 1 < argc)
+            config_path = argv[++i];
+        else if (arg == "--seat" && i + 1 < argc)
+            seat = argv[++i];
+        else if (arg == "--record" && i + 1 < argc)
+            record_path = argv[++i];
+        else if (arg == "--replay" && i + 1 < argc)
+            replay_path = argv[++i];
+        else if (arg == "--fast")
+            fast = true;
+        else if (arg == "--dry-run")
+            dry_run = true;
+        else if (arg == "--log-level" && i + 1 < argc && parse_log_level(argv[i + 1], level))
+            ++i;
+        else if (arg == "--control" && i + 1 < argc)
+        {
+            control_path = argv[++i];
+            control_given = true;
+        }
+        else if (arg == "--no-control")
+            control_path.clear();
+        else if (arg == "--realtime" && i + 1 < argc && parse_int(argv[i + 1], 1, 99, scheduling.realtime_priority))
+            ++i;
+        else if (arg == "--nice" && i + 1 < argc && parse_int(argv[i + 1], -20, 19, scheduling.nice))
+            ++i;
+        else if (arg == "--cpu" && i + 1 < argc && parse_int(argv[i + 1], 0, CPU_SETSIZE - 1, scheduling.cpu))
+            ++i;
+        else if (arg == "--metrics-port" && i + 1 < argc && parse_int(argv[i + 1], 1, 65535, metrics_port))
+            ++i;
+        else if (arg == "--mlock")
+            scheduling.lock_memory = true;
+        else if (arg[0] != '-')
+            device_paths.push_back(argv[i]);
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!record_path.empty() && !replay_path.empty())
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+#ifndef WITH_GUI
+    headless = true;
+#endif
+
+    // Started before anything logs, stopped after every other thread
+    set_log_level(level);
+    LogWriter log_writer;
+
+    // An explicit text config wins; otherwise prefer the binary store the
+    // GUI saves, falling back to the default text config
+    BindingConfig config;
+    bool loaded;
+    bool from_store = false;
+    if (!config_path.empty())
+    {
+        loaded = load_bindings(config_path, config.bindings);
+    }
+    else if (load_binding_store(store_path, config))
+    {
+        loaded = true;
+        from_store = true;
+        config_path = store_path;
+    }
+    else
+    {
+        config_path = default_config_path();
+        loaded = load_bindings(config_path, config.bindings);
+    }
+
+    if (loaded)
+        LOG(Info) << "Loaded " << config.bindings.bound_count() << " binding(s) from " << config_path;
+    else if (headless)
+        LOG(Warn) << "No bindings loaded: cannot read " << config_path;
+
+    Snapshot<BindingTable> binding_snapshot(std::make_unique<BindingTable>(config.bindings));
+
+    // A replay needs no devices at all. Explicit paths get a fixed device
+    // list; otherwise follow the udev seat so devices can be hotplugged.
+    std::vector<TraceEvent> replay_events;
+    struct udev *udev = nullptr;
+    struct libinput *li = nullptr;
+    if (!replay_path.empty())
+    {
+        if (!load_trace(replay_path, replay_events))
+            return 1;
+        LOG(Info) << "Replaying " << replay_events.size() << " events from " << replay_path
+                  << (fast ? " as fast as possible" : "");
+    }
+    else if (!device_paths.empty())
+    {
+        li = libinput_path_create_context(&interface, nullptr);
+        if (!li)
+        {
+            LOG(Error) << "Failed to create libinput context";
+            return 1;
+        }
+
+        for (const char *device_path : device_paths)
+        {
+            struct libinput_device *device = libinput_path_add_device(li, device_path);
+            if (!device)
+            {
+                LOG(Error) << "Failed to add device: " << device_path;
+                libinput_unref(li);
+                return 1;
+            }
+            LOG(Info) << "Listening for events on: " << device_path;
+        }
+    }
+    else
+    {
+        udev = udev_new();
+        if (!udev)
+        {
+            LOG(Error) << "Failed to initialize udev";
+            return 1;
+        }
+
+        li = libinput_udev_create_context(&interface, nullptr, udev);
+        if (!li || libinput_udev_assign_seat(li, seat) != 0)
+        {
+            LOG(Error) << "Failed to create libinput context for seat " << seat;
+            if (li)
+                libinput_unref(li);
+            udev_unref(udev);
+            return 1;
+        }
+
+        LOG(Info) << "Listening for events on seat: " << seat;
+    }
+
+    // Block termination signals before any thread starts so they all
+    // inherit the mask and the main loop can pick them up via signalfd
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    // Process-wide, so before the other threads start allocating; children
+    // don't inherit it
+    if (scheduling.lock_memory && lock_memory())
+        LOG(Info) << "Locked daemon memory";
+
+    Executor executor;
+    if (!executor.start())
+    {
+        LOG(Error) << "Failed to start command executor";
+        return 1;
+    }
+
+    TraceWriter trace_writer;
+    if (!record_path.empty())
+    {
+        if (!trace_writer.open(record_path))
+            return 1;
+        LOG(Info) << "Recording events to " << record_path;
+    }
+
+    // Only an explicitly requested socket is worth failing over
+    ControlServer control(binding_snapshot, executor, store_path, config.user_commands);
+    if (!control_path.empty() && !control.open(control_path) && control_given)
+        return 1;
+
+    // Asked for explicitly, so worth failing over like the socket
+    MetricsServer metrics;
+    if (metrics_port && !metrics.start((uint16_t)metrics_port))
+        return 1;
+
+    // The GUI owns the bindings while it is open; otherwise the file does.
+    // A file that doesn't exist yet is picked up once it is created.
+    ConfigWatcher watcher(binding_snapshot, config_path, from_store);
+    if (headless)
+        watcher.start();
+
+    int gui_fd = -1;
+#ifdef WITH_GUI
+    gui_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (gui_fd < 0)
+    {
+        LOG(Error) << "Failed to create eventfd: " << std::strerror(errno);
+        return 1;
+    }
+    control.set_gui_fd(gui_fd);
+#endif
+
+    // Replays stay on the global bindings so they behave the same anywhere
+    ActiveWindow active_window;
+    bool follow_window = replay_path.empty() && active_window.start();
+
+    InputThread input(li, binding_snapshot, executor);
+    if (!record_path.empty())
+        input.set_trace_writer(&trace_writer);
+    if (!replay_path.empty())
+        input.set_replay(&replay_events, fast);
+    input.set_dry_run(dry_run);
+    input.set_scheduling(scheduling);
+    if (control.is_open())
+        input.set_control_server(&control);
+    if (follow_window)
+        input.set_active_window(&active_window);
+    if (!input.start())
+    {
+        LOG(Error) << "Failed to start input thread";
+        return 1;
+    }
+
+    std::function<void(Reactor &)> show_gui;
+#ifdef WITH_GUI
+    // Each time, the window starts from the bindings as they are by then,
+    // which the socket or the file may have changed since it last closed
+    show_gui = [&](Reactor &events) {
+        watcher.stop();
+        control.set_read_only(true);
+        config.bindings = *binding_snapshot.copy();
+        if (run_gui(config, store_path, binding_snapshot, input, executor, events) == 0)
+            LOG(Info) << "Window closed, gestures are still handled";
+        control.set_user_commands(config.user_commands);
+        control.set_read_only(false);
+        watcher.start();
+    };
+#endif
+    int ret = run_daemon(input, signals, gui_fd, !headless, show_gui);
+
+    // Cleanup
+    watcher.stop();
+    input.stop();
+    active_window.stop();
+    executor.stop();
+    metrics.stop();
+
+    if (!record_path.empty())
+    {
+        trace_writer.close();
+        LOG(Info) << "Recorded " << trace_writer.count() << " events to " << record_path;
+    }
+
+    if (gui_fd >= 0)
+        close(gui_fd);
+    if (li)
+        libinput_unref(li);
+    if (udev)
+        udev_unref(udev);
+    return ret;
+}
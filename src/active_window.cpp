@@ -0,0 +1,144 @@
+#include "active_window.h"
+
+#include "log.h"
+
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+// The active window can be destroyed between reading _NET_ACTIVE_WINDOW and
+// asking for its class; the default handler would exit the process over the
+// resulting BadWindow.
+static int ignore_x_error(Display *, XErrorEvent *)
+{
+    return 0;
+}
+
+static void copy_name(char (&out)[64], const char *name)
+{
+    std::strncpy(out, name ? name : "", sizeof(out) - 1);
+    out[sizeof(out) - 1] = '\0';
+}
+
+ActiveWindow::~ActiveWindow()
+{
+    stop();
+}
+
+bool ActiveWindow::start()
+{
+    const char *name = std::getenv("DISPLAY");
+    if (!name || !*name)
+    {
+        LOG(Info) << "No X display, application profiles are disabled";
+        return false;
+    }
+
+    display_ = XOpenDisplay(name);
+    if (!display_)
+    {
+        LOG(Warn) << "Failed to open display " << name << ", application profiles are disabled";
+        return false;
+    }
+    XSetErrorHandler(ignore_x_error);
+
+    root_ = DefaultRootWindow(display_);
+    active_atom_ = XInternAtom(display_, "_NET_ACTIVE_WINDOW", False);
+    XSelectInput(display_, root_, PropertyChangeMask);
+
+    changed_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (changed_fd_ < 0)
+    {
+        LOG(Error) << "Failed to create eventfd: " << std::strerror(errno);
+        stop();
+        return false;
+    }
+    if (!reactor_.open() || !reactor_.add(ConnectionNumber(display_), EPOLLIN, [this](uint32_t) { read_events(); }))
+    {
+        stop();
+        return false;
+    }
+
+    update();
+    thread_ = std::thread([this] { reactor_.run(); });
+    return true;
+}
+
+void ActiveWindow::stop()
+{
+    if (thread_.joinable())
+    {
+        reactor_.stop();
+        thread_.join();
+    }
+    reactor_.close();
+    if (display_)
+    {
+        XCloseDisplay(display_);
+        display_ = nullptr;
+    }
+    if (changed_fd_ >= 0)
+    {
+        close(changed_fd_);
+        changed_fd_ = -1;
+    }
+}
+
+void ActiveWindow::read_events()
+{
+    bool changed = false;
+    while (XPending(display_))
+    {
+        XEvent event;
+        XNextEvent(display_, &event);
+        if (event.type == PropertyNotify && event.xproperty.atom == active_atom_)
+            changed = true;
+    }
+    if (changed)
+        update();
+}
+
+void ActiveWindow::update()
+{
+    Window active = None;
+    Atom type;
+    int format;
+    unsigned long count, remaining;
+    unsigned char *data = nullptr;
+    if (XGetWindowProperty(display_, root_, active_atom_, 0, 1, False, XA_WINDOW, &type, &format, &count,
+                           &remaining, &data) == Success && data)
+    {
+        // Format 32 properties come back as longs
+        if (type == XA_WINDOW && format == 32 && count == 1)
+            active = *(Window *)data;
+        XFree(data);
+    }
+
+    ActiveApp app;
+    XClassHint hint = {};
+    if (active != None && XGetClassHint(display_, active, &hint))
+    {
+        copy_name(app.instance, hint.res_name);
+        copy_name(app.wm_class, hint.res_class);
+        XFree(hint.res_name);
+        XFree(hint.res_class);
+    }
+
+    if (std::strcmp(app.instance, local_app_.instance) == 0 && std::strcmp(app.wm_class, local_app_.wm_class) == 0)
+        return;
+
+    local_app_ = app;
+    app_.store(app);
+    LOG(Debug) << "Active application: " << (app.wm_class[0] ? app.wm_class : "none");
+
+    uint64_t one = 1;
+    ssize_t ret = write(changed_fd_, &one, sizeof(one));
+    (void)ret;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <thread>
+
+#include "reactor.h"
+#include "seqlock.h"
+
+struct _XDisplay;
+
+// The focused application, as the two halves of its WM_CLASS
+struct ActiveApp {
+    char instance[64] = {};     // res_name, e.g. "navigator"
+    char wm_class[64] = {};     // res_class, e.g. "firefox"
+};
+
+// Follows the focused X11 window on a thread of its own, via PropertyNotify
+// on the root window's _NET_ACTIVE_WINDOW, so the input thread can pick the
+// binding profile for it without ever talking to the X server. current() is
+// a SeqLock read; changed_fd() becomes readable whenever it changes.
+//
+// Needs an EWMH window manager. Wayland has no common way to learn the
+// focused application, so there, and without a display, start() fails and
+// only the global bindings apply.
+class ActiveWindow {
+public:
+    ActiveWindow() = default;
+    ~ActiveWindow();
+
+    ActiveWindow(const ActiveWindow &) = delete;
+    ActiveWindow &operator=(const ActiveWindow &) = delete;
+
+    bool start();
+    void stop();
+
+    ActiveApp current() const { return app_.load(); }
+
+    // eventfd; read it to clear
+    int changed_fd() const { return changed_fd_; }
+
+private:
+    void read_events();
+    void update();
+
+    struct _XDisplay *display_ = nullptr;
+    unsigned long root_ = 0;
+    unsigned long active_atom_ = 0;
+
+    ActiveApp local_app_;
+    SeqLock<ActiveApp> app_;
+
+    Reactor reactor_;
+    int changed_fd_ = -1;
+    std::thread thread_;
+};
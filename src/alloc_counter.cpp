@@ -0,0 +1,56 @@
+#include "alloc_counter.h"
+
+#include <cstdlib>
+#include <new>
+
+#if defined(DEBUG) || defined(COUNT_ALLOCATIONS)
+
+static thread_local uint64_t thread_allocations = 0;
+
+void *operator new(std::size_t size)
+{
+    thread_allocations++;
+    void *p = std::malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+uint64_t thread_allocation_count()
+{
+    return thread_allocations;
+}
+
+#else
+
+uint64_t thread_allocation_count()
+{
+    return 0;
+}
+
+#endif
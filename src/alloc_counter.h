@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstdint>
+
+// Debug builds replace the global operator new to count heap allocations per
+// thread, so the input thread can check that handling an event allocates
+// nothing; COUNT_ALLOCATIONS does the same for gesture_bench. Release builds
+// keep the default allocator and always report 0.
+uint64_t thread_allocation_count();
@@ -0,0 +1,196 @@
+#include "binding_editor.h"
+
+#include <algorithm>
+#include <memory>
+
+// Default options
+static const char *const PREDEFINED_COMMANDS[] = {
+    "None",
+    "notify-send 'Gesture Triggered'",
+    // Launch terminal
+    "gnome-terminal",
+    // Launch Google Chrome
+    "google-chrome",
+    // Media controls
+    "playerctl play-pause",
+    "playerctl next",
+    "playerctl previous",
+    // Built-in actions, no process started
+    "notify:Gesture Triggered",
+    "mpris:PlayPause",
+    "mpris:Next",
+    "mpris:Previous",
+    "key:super+Page_Up",
+    "key:super+Page_Down",
+    "key:XF86AudioRaiseVolume",
+    "key:XF86AudioLowerVolume"
+};
+
+// Gestures shown in the editor, one row per variant
+struct EditorGroup {
+    GestureKind kind;
+    int fingers;
+};
+
+static const EditorGroup EDITOR_GROUPS[] = {
+    {GestureKind::Swipe, 3},
+    {GestureKind::Swipe, 4},
+    {GestureKind::Pinch, 2},
+    {GestureKind::Pinch, 3},
+    {GestureKind::Hold, 3},
+    {GestureKind::Hold, 4},
+    {GestureKind::Scroll, 2},
+};
+
+BindingEditor::BindingEditor(const BindingConfig &initial)
+    : table_(initial.bindings), user_commands_(initial.user_commands)
+{
+    for (const EditorGroup &group : EDITOR_GROUPS)
+    {
+        for (int v = 0; v < GESTURE_VARIANT_COUNT; ++v)
+        {
+            if (!gesture_variant_valid(group.kind, v))
+                continue;
+
+            Row row;
+            row.key = make_gesture_key(group.kind, group.fingers, v);
+            row.label = std::to_string(group.fingers) + "F " + gesture_kind_name(group.kind) + " " +
+                        gesture_variant_name(row.key);
+            rows_.push_back(std::move(row));
+        }
+    }
+
+    // Commands loaded from disk show up as custom entries
+    for (const CommandRef &cmd : table_.slots)
+    {
+        if (cmd && std::find(std::begin(PREDEFINED_COMMANDS), std::end(PREDEFINED_COMMANDS), cmd->text) == std::end(PREDEFINED_COMMANDS) &&
+            std::find(user_commands_.begin(), user_commands_.end(), cmd->text) == user_commands_.end())
+        {
+            user_commands_.push_back(cmd->text);
+        }
+    }
+    rebuild_commands();
+}
+
+bool BindingEditor::add_command(const std::string &command)
+{
+    if (command.empty())
+        return false;
+
+    refresh();
+    if (command_index_.count(command))
+        return false;
+
+    user_commands_.push_back(command);
+    commands_dirty_ = true;
+    mark_changed();
+    return true;
+}
+
+void BindingEditor::bind(size_t row, int command_index)
+{
+    refresh();
+    Row &r = rows_[row];
+    r.selected = command_index;
+
+    if (command_index == 0)
+        table_[r.key].reset();
+    else
+        table_[r.key] = std::make_shared<Command>(commands_[command_index],
+                                                  table_[r.key] ? table_[r.key]->options : CommandOptions());
+    mark_changed();
+}
+
+void BindingEditor::set_options(size_t row, const CommandOptions &options)
+{
+    CommandRef &bound = table_[rows_[row].key];
+    if (!bound || bound->options == options)
+        return;
+
+    bound = std::make_shared<Command>(bound->text, options);
+    mark_changed();
+}
+
+const FingerThresholds *BindingEditor::device_thresholds(const std::string &device) const
+{
+    const DeviceThresholds *own = table_.find_device(device.c_str());
+    return own ? &own->fingers : nullptr;
+}
+
+void BindingEditor::set_device_thresholds(const std::string &device, const FingerThresholds &thresholds)
+{
+    for (DeviceThresholds &own : table_.devices)
+    {
+        if (own.device != device)
+            continue;
+        if (own.fingers == thresholds)
+            return;
+        own.fingers = thresholds;
+        mark_changed();
+        return;
+    }
+    table_.devices.push_back({device, thresholds});
+    mark_changed();
+}
+
+void BindingEditor::reset_device_thresholds(const std::string &device)
+{
+    auto it = std::find_if(table_.devices.begin(), table_.devices.end(),
+                           [&](const DeviceThresholds &own) { return own.device == device; });
+    if (it == table_.devices.end())
+        return;
+    table_.devices.erase(it);
+    mark_changed();
+}
+
+void BindingEditor::mark_changed()
+{
+    selection_dirty_ = true;
+    changed_ = true;
+}
+
+void BindingEditor::refresh()
+{
+    if (commands_dirty_)
+        rebuild_commands();
+    if (selection_dirty_)
+        sync_selected_commands();
+}
+
+void BindingEditor::rebuild_commands()
+{
+    commands_.assign(std::begin(PREDEFINED_COMMANDS), std::end(PREDEFINED_COMMANDS));
+    for (const std::string &cmd : user_commands_)
+    {
+        if (std::find(commands_.begin(), commands_.end(), cmd) == commands_.end())
+            commands_.push_back(cmd);
+    }
+
+    command_index_.clear();
+    for (int i = 0; i < (int)commands_.size(); ++i)
+        command_index_.emplace(commands_[i], i);
+
+    // Prune stale bindings
+    for (CommandRef &cmd : table_.slots)
+    {
+        if (cmd && !command_index_.count(cmd->text))
+        {
+            cmd.reset();
+            mark_changed();
+        }
+    }
+
+    commands_dirty_ = false;
+    selection_dirty_ = true;
+}
+
+void BindingEditor::sync_selected_commands()
+{
+    for (Row &row : rows_)
+    {
+        const CommandRef &cmd = table_[row.key];
+        auto it = cmd ? command_index_.find(cmd->text) : command_index_.end();
+        row.selected = it != command_index_.end() ? it->second : 0;
+    }
+    selection_dirty_ = false;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "binding_store.h"
+#include "bindings.h"
+
+// State behind the "Gesture Bindings" window, independent of ImGui.
+//
+// The command list, the command -> index lookup and each row's selected
+// entry are derived data. They are recomputed only when a command is added
+// or a binding changes, so drawing a frame allocates nothing.
+class BindingEditor {
+public:
+    struct Row {
+        GestureKey key;
+        std::string label;   // "3F LEFT"
+        int selected = 0;    // index into commands(), 0 = "None"
+    };
+
+    explicit BindingEditor(const BindingConfig &initial);
+
+    // "None", the presets, then user commands
+    const std::vector<std::string> &commands() { refresh(); return commands_; }
+    const std::vector<Row> &rows() { refresh(); return rows_; }
+
+    // Returns false for empty or duplicate commands
+    bool add_command(const std::string &command);
+
+    // command_index 0 unbinds
+    void bind(size_t row, int command_index);
+    void set_options(size_t row, const CommandOptions &options);
+
+    // A touchpad's own thresholds, or null while it uses the defaults
+    const FingerThresholds *device_thresholds(const std::string &device) const;
+    void set_device_thresholds(const std::string &device, const FingerThresholds &thresholds);
+    void reset_device_thresholds(const std::string &device);
+
+    const CommandRef &binding(size_t row) const { return table_[rows_[row].key]; }
+    const BindingTable &table() const { return table_; }
+    BindingConfig config() const { return {table_, user_commands_}; }
+
+    // True once after any change that should be published and saved
+    bool take_changed()
+    {
+        bool changed = changed_;
+        changed_ = false;
+        return changed;
+    }
+
+private:
+    void mark_changed();
+    void refresh();
+    void rebuild_commands();
+    void sync_selected_commands();
+
+    BindingTable table_;
+    std::vector<std::string> user_commands_;
+
+    std::vector<std::string> commands_;
+    std::unordered_map<std::string, int> command_index_;
+    std::vector<Row> rows_;
+
+    bool commands_dirty_ = true;
+    bool selection_dirty_ = true;
+    bool changed_ = false;
+};
@@ -0,0 +1,444 @@
+#include "binding_store.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include "config.h"
+#include "log.h"
+
+static const char STORE_MAGIC[8] = {'G', 'S', 'T', 'B', 'I', 'N', 'D', '\0'};
+static const uint32_t STORE_VERSION = 1;
+
+struct StoreHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t binding_count;
+    uint32_t command_count;
+    uint32_t strings_size;
+    uint32_t checksum;
+    uint32_t profile_count;
+    uint32_t device_count;
+    uint32_t sequence_count;
+};
+
+enum StoreBindingFlags : uint8_t {
+    STORE_DROP_IF_RUNNING = 1 << 0,
+    STORE_CANCEL_IF_REVERSED = 1 << 1,
+    STORE_STREAM = 1 << 2,
+    STORE_COALESCE = 1 << 3,
+};
+
+// Throttles, shared by bindings and sequences
+struct StoreThrottle {
+    uint32_t debounce_ms;
+    uint32_t limit_count;       // 0 = unlimited
+    float limit_seconds;
+};
+
+struct StoreBinding {
+    uint8_t fingers;
+    uint8_t variant;
+    uint8_t flags;
+    uint8_t kind;
+    uint32_t command_offset;
+    uint32_t command_length;
+    float early_distance;
+    float stream_step;
+    uint32_t stream_rate;
+    uint32_t profile;           // 0 = global, else index + 1 into the profile names
+    StoreThrottle throttle;
+};
+
+struct StoreString {
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct StoreThresholds {
+    float swipe_mm;
+    float pinch_in;
+    float pinch_out;
+};
+
+// Thresholds of one touchpad, for every finger count
+struct StoreDevice {
+    StoreString name;
+    StoreThresholds fingers[GESTURE_MAX_FINGERS + 1];
+};
+
+// A sequence binding; keys past length are 0
+struct StoreSequence {
+    uint16_t keys[SEQUENCE_MAX_LENGTH];     // GestureKeys
+    uint8_t length;
+    uint8_t flags;                          // STORE_DROP_IF_RUNNING, STORE_COALESCE
+    uint16_t reserved;
+    uint32_t window_ms;
+    uint32_t profile;                       // as in StoreBinding
+    StoreString command;
+    StoreThrottle throttle;
+};
+
+static void load_throttle(const StoreThrottle &stored, uint8_t flags, CommandOptions &options)
+{
+    options.coalesce = flags & STORE_COALESCE;
+    options.debounce_ms = (int)stored.debounce_ms;
+    options.limit_count = (int)stored.limit_count;
+    options.limit_seconds = stored.limit_seconds > 0.0f ? stored.limit_seconds : 1.0;
+}
+
+static StoreThrottle save_throttle(const CommandOptions &options)
+{
+    return {(uint32_t)std::max(options.debounce_ms, 0), (uint32_t)std::max(options.limit_count, 0),
+            (float)options.limit_seconds};
+}
+
+// FNV-1a
+static uint32_t checksum(const unsigned char *data, size_t size)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+std::string default_store_path()
+{
+    return config_dir() + "/bindings.bin";
+}
+
+static bool parse_store(const unsigned char *data, size_t size, BindingConfig &config)
+{
+    if (size < sizeof(StoreHeader))
+        return false;
+
+    StoreHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, STORE_MAGIC, sizeof(STORE_MAGIC)) != 0 || header.version != STORE_VERSION)
+        return false;
+
+    uint32_t profile_count = header.profile_count;
+    uint32_t sequence_count = header.sequence_count;
+    uint64_t expected = sizeof(StoreHeader)
+                      + (uint64_t)header.binding_count * sizeof(StoreBinding)
+                      + ((uint64_t)header.command_count + profile_count) * sizeof(StoreString)
+                      + (uint64_t)header.device_count * sizeof(StoreDevice)
+                      + (uint64_t)sequence_count * sizeof(StoreSequence)
+                      + header.strings_size;
+    if (expected != size)
+        return false;
+    if (checksum(data + sizeof(StoreHeader), size - sizeof(StoreHeader)) != header.checksum)
+        return false;
+
+    const unsigned char *records = data + sizeof(StoreHeader);
+    const unsigned char *commands = records + header.binding_count * sizeof(StoreBinding);
+    const unsigned char *profiles = commands + header.command_count * sizeof(StoreString);
+    const unsigned char *devices = profiles + profile_count * sizeof(StoreString);
+    const unsigned char *sequences = devices + header.device_count * sizeof(StoreDevice);
+    const char *strings = (const char *)(sequences + sequence_count * sizeof(StoreSequence));
+
+    auto in_pool = [&](uint32_t offset, uint32_t length) {
+        return (uint64_t)offset + length <= header.strings_size;
+    };
+
+    BindingConfig parsed;
+    for (uint32_t i = 0; i < profile_count; ++i)
+    {
+        StoreString record;
+        std::memcpy(&record, profiles + i * sizeof(StoreString), sizeof(record));
+        if (record.length == 0 || !in_pool(record.offset, record.length))
+            return false;
+        parsed.bindings.profiles.push_back({std::string(strings + record.offset, record.length), {}, {}, nullptr});
+    }
+
+    for (uint32_t i = 0; i < header.binding_count; ++i)
+    {
+        StoreBinding record;
+        std::memcpy(&record, records + i * sizeof(StoreBinding), sizeof(record));
+        if (!gesture_variant_valid((GestureKind)record.kind, record.variant) || !gesture_fingers_valid(record.fingers) ||
+            record.command_length == 0 || !in_pool(record.command_offset, record.command_length) ||
+            record.profile > profile_count)
+            return false;
+
+        std::string command(strings + record.command_offset, record.command_length);
+        GestureKey key = make_gesture_key((GestureKind)record.kind, record.fingers, record.variant);
+        CommandOptions options;
+        options.drop_if_running = record.flags & STORE_DROP_IF_RUNNING;
+        options.cancel_if_reversed = record.flags & STORE_CANCEL_IF_REVERSED;
+        options.early_distance = record.early_distance > 0.0f ? record.early_distance : 0.0;
+        options.stream = record.flags & STORE_STREAM;
+        options.stream_step = record.stream_step;
+        options.stream_rate = (int)record.stream_rate;
+        load_throttle(record.throttle, record.flags, options);
+        BindingSlots &slots = record.profile ? parsed.bindings.profiles[record.profile - 1].slots : parsed.bindings.slots;
+        slots[key] = std::make_shared<Command>(std::move(command), options);
+    }
+
+    for (uint32_t i = 0; i < header.command_count; ++i)
+    {
+        StoreString record;
+        std::memcpy(&record, commands + i * sizeof(StoreString), sizeof(record));
+        if (!in_pool(record.offset, record.length))
+            return false;
+        parsed.user_commands.emplace_back(strings + record.offset, record.length);
+    }
+
+    for (uint32_t i = 0; i < header.device_count; ++i)
+    {
+        StoreDevice record;
+        std::memcpy(&record, devices + i * sizeof(StoreDevice), sizeof(record));
+        if (record.name.length == 0 || !in_pool(record.name.offset, record.name.length))
+            return false;
+
+        DeviceThresholds device;
+        device.device.assign(strings + record.name.offset, record.name.length);
+        for (int fingers = 0; fingers <= GESTURE_MAX_FINGERS; ++fingers)
+        {
+            const StoreThresholds &stored = record.fingers[fingers];
+            GestureThresholds &thresholds = device.fingers[fingers];
+            thresholds.swipe_mm = stored.swipe_mm;
+            thresholds.pinch_in = stored.pinch_in;
+            thresholds.pinch_out = stored.pinch_out;
+            if (!gesture_thresholds_sane(thresholds))
+                return false;
+        }
+        parsed.bindings.devices.push_back(std::move(device));
+    }
+
+    for (uint32_t i = 0; i < sequence_count; ++i)
+    {
+        StoreSequence record;
+        std::memcpy(&record, sequences + i * sizeof(StoreSequence), sizeof(record));
+        if (record.length < 2 || record.length > SEQUENCE_MAX_LENGTH || record.window_ms == 0 ||
+            record.command.length == 0 || !in_pool(record.command.offset, record.command.length) ||
+            record.profile > profile_count)
+            return false;
+
+        SequenceBinding sequence;
+        for (uint8_t k = 0; k < record.length; ++k)
+        {
+            GestureKey key = record.keys[k];
+            if (key >= GESTURE_KEY_COUNT || !gesture_variant_valid(gesture_kind(key), gesture_variant(key)) ||
+                !gesture_fingers_valid(gesture_fingers(key)))
+                return false;
+            sequence.keys.push_back(key);
+        }
+        sequence.window_ms = record.window_ms;
+        CommandOptions options;
+        options.drop_if_running = record.flags & STORE_DROP_IF_RUNNING;
+        load_throttle(record.throttle, record.flags, options);
+        sequence.command = std::make_shared<Command>(std::string(strings + record.command.offset, record.command.length),
+                                                     options);
+        set_sequence(record.profile ? parsed.bindings.profiles[record.profile - 1].sequences : parsed.bindings.sequences,
+                     std::move(sequence));
+    }
+    parsed.bindings.compile_sequences();
+
+    config = std::move(parsed);
+    return true;
+}
+
+bool load_binding_store(const std::string &path, BindingConfig &config)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    size_t size = (size_t)st.st_size;
+    void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    bool ok = parse_store((const unsigned char *)map, size, config);
+    munmap(map, size);
+
+    if (!ok)
+        LOG(Warn) << "Ignoring invalid binding store: " << path;
+    return ok;
+}
+
+static bool make_dirs(const std::string &dir)
+{
+    for (size_t pos = 1; pos <= dir.size(); ++pos)
+    {
+        if (pos != dir.size() && dir[pos] != '/')
+            continue;
+        std::string prefix = dir.substr(0, pos);
+        if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST)
+            return false;
+    }
+    return true;
+}
+
+bool save_binding_store(const std::string &path, const BindingConfig &config)
+{
+    std::vector<StoreBinding> records;
+    std::vector<StoreString> commands;
+    std::string strings;
+
+    auto add_slots = [&](const BindingSlots &slots, uint32_t profile) {
+        for (size_t key = 0; key < GESTURE_KEY_COUNT; ++key)
+        {
+            const CommandRef &command = slots[key];
+            if (!command || command->text.empty())
+                continue;
+
+            StoreBinding record = {};
+            record.fingers = (uint8_t)gesture_fingers(key);
+            record.variant = (uint8_t)gesture_variant(key);
+            record.kind = (uint8_t)gesture_kind(key);
+            record.flags = (command->options.drop_if_running ? STORE_DROP_IF_RUNNING : 0) |
+                           (command->options.cancel_if_reversed ? STORE_CANCEL_IF_REVERSED : 0) |
+                           (command->options.stream ? STORE_STREAM : 0) |
+                           (command->options.coalesce ? STORE_COALESCE : 0);
+            record.early_distance = (float)command->options.early_distance;
+            record.stream_step = (float)command->options.stream_step;
+            record.stream_rate = (uint32_t)command->options.stream_rate;
+            record.profile = profile;
+            record.throttle = save_throttle(command->options);
+            record.command_offset = (uint32_t)strings.size();
+            record.command_length = (uint32_t)command->text.size();
+            strings += command->text;
+            records.push_back(record);
+        }
+    };
+
+    add_slots(config.bindings.slots, 0);
+    for (size_t i = 0; i < config.bindings.profiles.size(); ++i)
+        add_slots(config.bindings.profiles[i].slots, (uint32_t)i + 1);
+
+    for (const std::string &command : config.user_commands)
+    {
+        commands.push_back({(uint32_t)strings.size(), (uint32_t)command.size()});
+        strings += command;
+    }
+
+    std::vector<StoreString> profiles;
+    for (const BindingProfile &profile : config.bindings.profiles)
+    {
+        profiles.push_back({(uint32_t)strings.size(), (uint32_t)profile.app.size()});
+        strings += profile.app;
+    }
+
+    std::vector<StoreDevice> devices;
+    for (const DeviceThresholds &device : config.bindings.devices)
+    {
+        StoreDevice record = {};
+        record.name = {(uint32_t)strings.size(), (uint32_t)device.device.size()};
+        strings += device.device;
+        for (int fingers = 0; fingers <= GESTURE_MAX_FINGERS; ++fingers)
+        {
+            const GestureThresholds &thresholds = device.fingers[fingers];
+            record.fingers[fingers] = {thresholds.swipe_mm, thresholds.pinch_in, thresholds.pinch_out};
+        }
+        devices.push_back(record);
+    }
+
+    std::vector<StoreSequence> sequences;
+    auto add_sequences = [&](const std::vector<SequenceBinding> &bound, uint32_t profile) {
+        for (const SequenceBinding &sequence : bound)
+        {
+            StoreSequence record = {};
+            for (size_t k = 0; k < sequence.keys.size() && k < SEQUENCE_MAX_LENGTH; ++k)
+                record.keys[k] = sequence.keys[k];
+            record.length = (uint8_t)std::min(sequence.keys.size(), SEQUENCE_MAX_LENGTH);
+            const CommandOptions &options = sequence.command->options;
+            record.flags = (options.drop_if_running ? STORE_DROP_IF_RUNNING : 0) |
+                           (options.coalesce ? STORE_COALESCE : 0);
+            record.throttle = save_throttle(options);
+            record.window_ms = sequence.window_ms;
+            record.profile = profile;
+            record.command = {(uint32_t)strings.size(), (uint32_t)sequence.command->text.size()};
+            strings += sequence.command->text;
+            sequences.push_back(record);
+        }
+    };
+    add_sequences(config.bindings.sequences, 0);
+    for (size_t i = 0; i < config.bindings.profiles.size(); ++i)
+        add_sequences(config.bindings.profiles[i].sequences, (uint32_t)i + 1);
+
+    std::string body;
+    body.append((const char *)records.data(), records.size() * sizeof(StoreBinding));
+    body.append((const char *)commands.data(), commands.size() * sizeof(StoreString));
+    body.append((const char *)profiles.data(), profiles.size() * sizeof(StoreString));
+    body.append((const char *)devices.data(), devices.size() * sizeof(StoreDevice));
+    body.append((const char *)sequences.data(), sequences.size() * sizeof(StoreSequence));
+    body += strings;
+
+    StoreHeader header = {};
+    std::memcpy(header.magic, STORE_MAGIC, sizeof(STORE_MAGIC));
+    header.version = STORE_VERSION;
+    header.binding_count = (uint32_t)records.size();
+    header.command_count = (uint32_t)commands.size();
+    header.strings_size = (uint32_t)strings.size();
+    header.profile_count = (uint32_t)profiles.size();
+    header.device_count = (uint32_t)devices.size();
+    header.sequence_count = (uint32_t)sequences.size();
+    header.checksum = checksum((const unsigned char *)body.data(), body.size());
+
+    size_t slash = path.rfind('/');
+    std::string dir = slash == std::string::npos ? "." : path.substr(0, slash);
+    if (!make_dirs(dir))
+    {
+        LOG(Error) << "Failed to create " << dir << ": " << std::strerror(errno);
+        return false;
+    }
+
+    std::string tmp_path = path + ".tmp";
+    int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        LOG(Error) << "Failed to write " << tmp_path << ": " << std::strerror(errno);
+        return false;
+    }
+
+    std::string file((const char *)&header, sizeof(header));
+    file += body;
+
+    bool ok = true;
+    size_t written = 0;
+    while (ok && written < file.size())
+    {
+        ssize_t n = write(fd, file.data() + written, file.size() - written);
+        if (n < 0 && errno == EINTR)
+            continue;
+        ok = n > 0;
+        if (ok)
+            written += (size_t)n;
+    }
+    ok = ok && fsync(fd) == 0;
+    close(fd);
+
+    if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0)
+    {
+        LOG(Error) << "Failed to save binding store " << path << ": " << std::strerror(errno);
+        unlink(tmp_path.c_str());
+        return false;
+    }
+
+    // Make the rename itself durable
+    int dir_fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd >= 0)
+    {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+    return true;
+}
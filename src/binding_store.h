@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "bindings.h"
+
+// Everything the GUI persists between runs
+struct BindingConfig {
+    BindingTable bindings;
+    std::vector<std::string> user_commands;
+};
+
+// Compact binary store, mapped read-only and validated in a single pass:
+//
+//     StoreHeader
+//     StoreBinding[binding_count]
+//     StoreString[command_count]     user commands
+//     StoreString[profile_count]     application names of the profiles
+//     StoreDevice[device_count]      touchpads with thresholds of their own
+//     StoreSequence[sequence_count]  sequence bindings
+//     char strings[strings_size]     string pool, not NUL-terminated
+//
+// All integers are host-endian; the header records a checksum of everything
+// after it.
+
+// <config_dir>/bindings.bin
+std::string default_store_path();
+
+// Returns false if the file is missing or fails validation; config is only
+// modified on success.
+bool load_binding_store(const std::string &path, BindingConfig &config);
+
+// Writes to a temporary file in the same directory, fsyncs it and renames it
+// over path, so readers never observe a partial store.
+bool save_binding_store(const std::string &path, const BindingConfig &config);
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <strings.h>
+#include <vector>
+
+#include "command.h"
+#include "gesture.h"
+#include "sequence_matcher.h"
+
+using BindingSlots = std::array<CommandRef, GESTURE_KEY_COUNT>;
+
+// Bindings that take over from the global ones while a given application
+// has the focus; empty slots fall through to the global binding
+struct BindingProfile {
+    std::string app;        // matched against either part of WM_CLASS, ignoring case
+    BindingSlots slots;
+    std::vector<SequenceBinding> sequences;
+
+    // The global sequences and these, by compile_sequences()
+    std::shared_ptr<const SequenceMatcher> matcher;
+};
+
+// Recognition thresholds chosen for one touchpad
+struct DeviceThresholds {
+    std::string device;     // libinput device name
+    FingerThresholds fingers;
+};
+
+// Flat dispatch table with one command slot per GestureKey, so a lookup is a
+// single array load. Published immutably to the input thread; editors copy
+// it, change slots and publish the copy, and Snapshot::publish() numbers its
+// version. Touchpads with thresholds of their own travel along, so they
+// reach the input thread the same way.
+//
+// Sequences are compiled into matchers by compile_sequences(), which
+// whoever changes them must call before publishing; copies share the
+// matchers.
+struct BindingTable {
+    uint64_t version = 0;
+    BindingSlots slots;
+    std::vector<BindingProfile> profiles;
+    std::vector<DeviceThresholds> devices;
+    std::vector<SequenceBinding> sequences;
+    std::shared_ptr<const SequenceMatcher> matcher;     // null without sequences
+
+    const CommandRef &operator[](GestureKey key) const { return slots[key]; }
+    CommandRef &operator[](GestureKey key) { return slots[key]; }
+
+    // Global and per-application bindings, sequences included
+    size_t bound_count() const
+    {
+        size_t n = count_slots(slots) + sequences.size();
+        for (const BindingProfile &profile : profiles)
+            n += count_slots(profile.slots) + profile.sequences.size();
+        return n;
+    }
+
+    // True if key runs something by itself or is part of a sequence
+    bool uses(GestureKey key) const { return slots[key] || (matcher && matcher->uses(key)); }
+
+    // A profile's sequences replace global ones with the same gestures
+    void compile_sequences()
+    {
+        std::vector<const SequenceBinding *> global;
+        for (const SequenceBinding &sequence : sequences)
+            global.push_back(&sequence);
+        matcher = global.empty() ? nullptr : std::make_shared<const SequenceMatcher>(global);
+
+        for (BindingProfile &profile : profiles)
+        {
+            std::vector<const SequenceBinding *> all = global;
+            for (const SequenceBinding &sequence : profile.sequences)
+                all.push_back(&sequence);
+            profile.matcher = all.empty() ? nullptr : std::make_shared<const SequenceMatcher>(all);
+        }
+    }
+
+    // The profile for an application, or -1; instance and wm_class are the
+    // two halves of WM_CLASS and either may be null
+    int find_profile(const char *instance, const char *wm_class) const
+    {
+        for (size_t i = 0; i < profiles.size(); ++i)
+        {
+            const char *app = profiles[i].app.c_str();
+            if ((instance && strcasecmp(app, instance) == 0) || (wm_class && strcasecmp(app, wm_class) == 0))
+                return (int)i;
+        }
+        return -1;
+    }
+
+    // Null if the device uses default_thresholds()
+    const DeviceThresholds *find_device(const char *name) const
+    {
+        for (const DeviceThresholds &device : devices)
+        {
+            if (device.device == name)
+                return &device;
+        }
+        return nullptr;
+    }
+
+    // Adds the profile if there's none for app yet
+    BindingProfile &profile(const std::string &app)
+    {
+        for (BindingProfile &profile : profiles)
+        {
+            if (strcasecmp(profile.app.c_str(), app.c_str()) == 0)
+                return profile;
+        }
+        profiles.push_back({app, {}, {}, nullptr});
+        return profiles.back();
+    }
+
+    // Global slots with profile's bound slots laid over them, into out,
+    // which also gets the profile's matcher
+    void overlay(int profile, BindingTable &out) const
+    {
+        out.matcher = profiles[profile].matcher;
+        out.slots = slots;
+        for (size_t key = 0; key < GESTURE_KEY_COUNT; ++key)
+        {
+            if (profiles[profile].slots[key])
+                out[key] = profiles[profile].slots[key];
+        }
+    }
+
+    // Puts previous's Command back into every binding that is the same there
+    // (same place, text and options), so a reload doesn't forget the running
+    // instances, debounce or rate limit of what it left alone. Recompiles
+    // the sequences.
+    void keep_commands(const BindingTable &previous)
+    {
+        keep_slots(previous.slots, slots);
+        keep_sequences(previous.sequences, sequences);
+        for (BindingProfile &profile : profiles)
+        {
+            int old = previous.find_profile(profile.app.c_str(), nullptr);
+            if (old < 0)
+                continue;
+            keep_slots(previous.profiles[old].slots, profile.slots);
+            keep_sequences(previous.profiles[old].sequences, profile.sequences);
+        }
+        compile_sequences();
+    }
+
+private:
+    static bool same_command(const CommandRef &a, const CommandRef &b)
+    {
+        return a && b && a->text == b->text && a->options == b->options;
+    }
+
+    static void keep_slots(const BindingSlots &previous, BindingSlots &slots)
+    {
+        for (size_t key = 0; key < GESTURE_KEY_COUNT; ++key)
+        {
+            if (same_command(previous[key], slots[key]))
+                slots[key] = previous[key];
+        }
+    }
+
+    static void keep_sequences(const std::vector<SequenceBinding> &previous, std::vector<SequenceBinding> &sequences)
+    {
+        for (SequenceBinding &sequence : sequences)
+        {
+            for (const SequenceBinding &before : previous)
+            {
+                if (before.keys == sequence.keys && same_command(before.command, sequence.command))
+                {
+                    sequence.command = before.command;
+                    break;
+                }
+            }
+        }
+    }
+
+    static size_t count_slots(const BindingSlots &slots)
+    {
+        size_t n = 0;
+        for (const CommandRef &slot : slots)
+            n += slot != nullptr;
+        return n;
+    }
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <time.h>
+
+// CLOCK_MONOTONIC, the same clock libinput timestamps events with
+inline uint64_t monotonic_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+inline uint64_t monotonic_us()
+{
+    return monotonic_ns() / 1000;
+}
+
+// Nanoseconds elapsed since a libinput (microsecond) timestamp
+inline uint64_t ns_since_us(uint64_t timestamp_us)
+{
+    uint64_t now = monotonic_ns();
+    uint64_t then = timestamp_us * 1000;
+    return now > then ? now - then : 0;
+}
@@ -0,0 +1,188 @@
+#include "command.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+
+// Characters that mean the text needs a real shell
+static const char SHELL_SYNTAX[] = "$`|&;<>()*?[]{}~#!\n";
+
+// Splits text into words if it only uses quoting a shell would treat
+// literally; returns false for anything else
+static bool split_words(const std::string &text, std::vector<std::string> &words)
+{
+    std::string word;
+    bool in_word = false;
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        char c = text[i];
+        if (c == ' ' || c == '\t')
+        {
+            if (in_word)
+                words.push_back(std::move(word));
+            word.clear();
+            in_word = false;
+            continue;
+        }
+
+        in_word = true;
+        if (c == '\'')
+        {
+            size_t end = text.find('\'', i + 1);
+            if (end == std::string::npos)
+                return false;
+            word.append(text, i + 1, end - i - 1);
+            i = end;
+        }
+        else if (c == '"')
+        {
+            size_t end = text.find('"', i + 1);
+            if (end == std::string::npos)
+                return false;
+            std::string quoted = text.substr(i + 1, end - i - 1);
+            if (quoted.find_first_of("$`\\!") != std::string::npos)
+                return false;
+            word += quoted;
+            i = end;
+        }
+        else if (c == '\\')
+        {
+            if (i + 1 >= text.size() || text[i + 1] == '\n')
+                return false;
+            word += text[++i];
+        }
+        else if (std::strchr(SHELL_SYNTAX, c))
+            return false;
+        else
+            word += c;
+    }
+    if (in_word)
+        words.push_back(std::move(word));
+
+    // Leading VAR=value assignments and shell keywords/builtins need sh
+    if (words.empty() || words[0].find('=') != std::string::npos)
+        return false;
+    static const char *const BUILTINS[] = {
+        "cd", "exec", "export", "set", "unset", "source", ".", "eval", "exit",
+        "if", "for", "while", "until", "case", "time", "alias", "ulimit", "umask",
+    };
+    for (const char *builtin : BUILTINS)
+    {
+        if (words[0] == builtin)
+            return false;
+    }
+    return true;
+}
+
+static bool is_executable(const std::string &path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode) && access(path.c_str(), X_OK) == 0;
+}
+
+// Absolute path of the program, or empty if it can't be found
+static std::string find_program(const std::string &name)
+{
+    if (name.find('/') != std::string::npos)
+        return is_executable(name) ? name : std::string();
+
+    const char *path = std::getenv("PATH");
+    std::string dirs = path ? path : "/usr/local/bin:/usr/bin:/bin";
+    size_t start = 0;
+    while (start <= dirs.size())
+    {
+        size_t end = dirs.find(':', start);
+        if (end == std::string::npos)
+            end = dirs.size();
+        std::string dir = end > start ? dirs.substr(start, end - start) : ".";
+        std::string candidate = dir + "/" + name;
+        if (is_executable(candidate))
+            return candidate;
+        start = end + 1;
+    }
+    return std::string();
+}
+
+struct ActionPrefix {
+    const char *prefix;
+    ActionType type;
+};
+
+static const ActionPrefix ACTION_PREFIXES[] = {
+    {"mpris:", ActionType::Mpris},
+    {"notify:", ActionType::Notify},
+    {"dbus:", ActionType::DBus},
+    {"key:", ActionType::Keys},
+};
+
+void Command::parse_action()
+{
+    for (const ActionPrefix &action : ACTION_PREFIXES)
+    {
+        size_t length = std::strlen(action.prefix);
+        if (text.compare(0, length, action.prefix) != 0)
+            continue;
+
+        type_ = action.type;
+        std::string rest = text.substr(length);
+        switch (type_)
+        {
+        case ActionType::Mpris:
+        {
+            size_t at = rest.find('@');
+            argv_.push_back(rest.substr(0, at));
+            argv_.push_back(at == std::string::npos ? std::string() : rest.substr(at + 1));
+            valid_ = !argv_[0].empty();
+            break;
+        }
+        case ActionType::Notify:
+            argv_.push_back(rest);
+            break;
+        case ActionType::DBus:
+        {
+            // INTERFACE.METHOD is split at the last dot
+            valid_ = split_words(rest, argv_) && argv_.size() >= 3 && argv_[2].rfind('.') != std::string::npos;
+            if (valid_)
+            {
+                size_t dot = argv_[2].rfind('.');
+                argv_.insert(argv_.begin() + 3, argv_[2].substr(dot + 1));
+                argv_[2].erase(dot);
+            }
+            break;
+        }
+        case ActionType::Keys:
+            valid_ = parse_key_combos(rest, keys_);
+            break;
+        case ActionType::Process:
+            break;
+        }
+        return;
+    }
+}
+
+Command::Command(std::string text, CommandOptions options)
+    : text(std::move(text)), options(options)
+{
+    parse_action();
+    if (type_ != ActionType::Process)
+        return;
+
+    if (!split_words(this->text, argv_))
+    {
+        argv_.clear();
+        return;
+    }
+
+    program_ = find_program(argv_[0]);
+    if (program_.empty())
+    {
+        argv_.clear();
+        return;
+    }
+
+    for (std::string &arg : argv_)
+        exec_argv_.push_back(&arg[0]);
+    exec_argv_.push_back(nullptr);
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "uinput_keyboard.h"
+
+// What a binding does when it fires. Everything but Process is handled
+// inside the executor without creating a process; the type comes from a
+// prefix on the text:
+//
+//     mpris:METHOD[@PLAYER]                 e.g. mpris:PlayPause, mpris:Next@spotify
+//     notify:SUMMARY                        desktop notification
+//     dbus:DEST PATH INTERFACE.METHOD [ARG...]  session bus call, string args
+//     key:COMBO [COMBO...]                  e.g. key:super+Page_Up, via uinput
+enum class ActionType : uint8_t {
+    Process,
+    Mpris,
+    Notify,
+    DBus,
+    Keys,
+};
+
+// Motion per streamed step unless a binding sets its own: millimetres for
+// swipes and scrolls, percent of scale for pinches
+constexpr double STREAM_STEP_MM = 1.0;
+constexpr double STREAM_STEP_PERCENT = 10.0;
+
+// Per-binding behaviour
+struct CommandOptions {
+    // Don't start another instance while a previous one is queued or running
+    bool drop_if_running = false;
+
+    // Fire as soon as the swipe has travelled this many millimetres in the
+    // bound direction instead of waiting for the fingers to lift (0 = off)
+    double early_distance = 0.0;
+
+    // Don't fire at SWIPE_END if the swipe pulled back from its furthest
+    // point by more than the recognition threshold
+    bool cancel_if_reversed = false;
+
+    // Stream the motion to a long-lived sink instead of running the command
+    // once. The text is then either "unix:PATH" or a command kept running
+    // with the stream on its stdin.
+    bool stream = false;
+
+    // Motion per streamed step (0 = STREAM_STEP_MM or STREAM_STEP_PERCENT),
+    // and the most writes per second a sink gets (0 = unlimited); steps in
+    // between are coalesced
+    double stream_step = 0.0;
+    int stream_rate = 60;
+
+    // Don't run again within this many milliseconds of the last run (0 = off)
+    int debounce_ms = 0;
+
+    // Token bucket: at most limit_count runs per limit_seconds, refilled
+    // steadily, so up to limit_count can run back to back (0 = unlimited)
+    int limit_count = 0;
+    double limit_seconds = 1.0;
+
+    // While an instance is running, hold back only the latest trigger and
+    // run it once that instance exits, rather than starting more alongside
+    bool coalesce = false;
+
+    bool operator==(const CommandOptions &other) const
+    {
+        return drop_if_running == other.drop_if_running &&
+               early_distance == other.early_distance &&
+               cancel_if_reversed == other.cancel_if_reversed &&
+               stream == other.stream &&
+               stream_step == other.stream_step &&
+               stream_rate == other.stream_rate &&
+               debounce_ms == other.debounce_ms &&
+               limit_count == other.limit_count &&
+               limit_seconds == other.limit_seconds &&
+               coalesce == other.coalesce;
+    }
+    bool operator!=(const CommandOptions &other) const { return !(*this == other); }
+};
+
+// A bound shell command. Immutable once bound, apart from the in-flight
+// counter and throttle state the executor keeps for it, so it can be shared
+// between the binding snapshot and queued jobs without copying the string.
+// Tables rebuilt by a reload or a socket edit hand an unchanged binding the
+// same Command (BindingTable::keep_commands), so that state carries over.
+//
+// Plain command lines (words and quotes, no expansions, redirections or
+// other shell syntax) are split into argv and the program looked up in PATH
+// once, here, so the executor can spawn them without a shell. Built-in
+// actions are parsed here too.
+struct Command {
+    explicit Command(std::string text, CommandOptions options = {});
+
+    Command(const Command &) = delete;
+    Command &operator=(const Command &) = delete;
+
+    ActionType type() const { return type_; }
+
+    // False for a built-in action whose text didn't parse
+    bool valid() const { return valid_; }
+
+    // Built-in action arguments: [method, player] for Mpris, [summary] for
+    // Notify, [dest, path, interface, method, args...] for DBus
+    const std::vector<std::string> &action_args() const { return argv_; }
+    const std::vector<KeyCombo> &keys() const { return keys_; }
+
+    // True if a Process command must go through /bin/sh -c
+    bool needs_shell() const { return program_.empty(); }
+
+    // Without a shell: the resolved program and a null-terminated argv
+    const std::string &program() const { return program_; }
+    char *const *argv() const { return exec_argv_.data(); }
+
+    const std::string text;
+    const CommandOptions options;
+
+    std::atomic<int> in_flight{0};
+
+    // Debounce and rate limit bookkeeping; only the executor thread touches
+    // these
+    uint64_t last_run_us = 0;
+    double tokens = 0.0;
+    uint64_t tokens_us = 0;     // when tokens was last refilled, 0 = never
+
+private:
+    void parse_action();
+
+    ActionType type_ = ActionType::Process;
+    bool valid_ = true;
+    std::vector<KeyCombo> keys_;
+
+    std::string program_;
+    std::vector<std::string> argv_;
+    std::vector<char *> exec_argv_;     // points into argv_
+};
+
+using CommandRef = std::shared_ptr<Command>;
@@ -0,0 +1,299 @@
+#include "config.h"
+
+#include "log.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+std::string config_dir()
+{
+    const char *xdg = std::getenv("XDG_CONFIG_HOME");
+    if (xdg && *xdg)
+        return std::string(xdg) + "/gesture-daemon";
+
+    const char *home = std::getenv("HOME");
+    return std::string(home ? home : ".") + "/.config/gesture-daemon";
+}
+
+std::string default_config_path()
+{
+    return config_dir() + "/bindings.conf";
+}
+
+// Reads "[kind] <fingers> <variant>", leaving fields after the variant.
+// more is set if a comma follows, attached to the variant or not.
+static bool parse_gesture_fields(std::istringstream &fields, GestureKey &key, bool &more)
+{
+    // A leading kind is optional and defaults to swipe
+    GestureKind kind = GestureKind::Swipe;
+    std::string first_word;
+    fields >> first_word;
+    if (parse_gesture_kind(first_word.c_str(), kind))
+        fields >> first_word;
+
+    int fingers = std::atoi(first_word.c_str());
+    std::string variant_name;
+    int variant;
+    if (!(fields >> variant_name))
+        return false;
+
+    // Whatever follows a comma in the same word is the next gesture's
+    size_t comma = variant_name.find(',');
+    more = comma != std::string::npos;
+    if (more)
+    {
+        fields.clear();
+        fields.seekg(-(std::streamoff)(variant_name.size() - comma - 1), std::ios_base::cur);
+        variant_name.resize(comma);
+    }
+    if (!gesture_fingers_valid(fingers) || !parse_gesture_variant(kind, variant_name.c_str(), variant))
+        return false;
+
+    if (!more)
+    {
+        fields >> std::ws;
+        if (fields.peek() == ',')
+        {
+            fields.get();
+            more = true;
+        }
+    }
+
+    key = make_gesture_key(kind, fingers, variant);
+    return true;
+}
+
+// One gesture, or several separated by commas
+static bool parse_gesture_list(std::istringstream &fields, std::vector<GestureKey> &keys)
+{
+    keys.clear();
+    bool more = true;
+    while (more)
+    {
+        GestureKey key;
+        if (!parse_gesture_fields(fields, key, more))
+            return false;
+        keys.push_back(key);
+    }
+    return true;
+}
+
+bool parse_gestures(const std::string &text, std::vector<GestureKey> &keys)
+{
+    std::istringstream fields(text);
+    std::string rest;
+    return parse_gesture_list(fields, keys) && keys.size() <= SEQUENCE_MAX_LENGTH && !(fields >> rest);
+}
+
+bool parse_binding(const std::string &line, SequenceBinding &binding, std::string &error)
+{
+    std::istringstream fields(line);
+    if (!parse_gesture_list(fields, binding.keys))
+    {
+        error = "expected '[kind] <fingers> <direction>[, ...] <command>'";
+        return false;
+    }
+    if (binding.keys.size() > SEQUENCE_MAX_LENGTH)
+    {
+        error = "a sequence has at most " + std::to_string(SEQUENCE_MAX_LENGTH) + " gestures";
+        return false;
+    }
+    bool sequence = binding.keys.size() > 1;
+
+    // Options come first; the first other word starts the command
+    CommandOptions options;
+    int window_ms = -1;
+    std::string text;
+    while (true)
+    {
+        fields >> std::ws;
+        std::streampos start = fields.tellg();
+        std::string token;
+        if (!(fields >> token))
+            break;
+
+        if (token == "drop")
+            options.drop_if_running = true;
+        else if (token == "cancel")
+            options.cancel_if_reversed = true;
+        else if (token.compare(0, 6, "early=") == 0)
+            options.early_distance = std::atof(token.c_str() + 6);
+        else if (token == "stream")
+            options.stream = true;
+        else if (token.compare(0, 5, "step=") == 0)
+            options.stream_step = std::atof(token.c_str() + 5);
+        else if (token.compare(0, 5, "rate=") == 0)
+            options.stream_rate = std::atoi(token.c_str() + 5);
+        else if (token.compare(0, 7, "within=") == 0)
+            window_ms = std::atoi(token.c_str() + 7);
+        else if (token.compare(0, 9, "debounce=") == 0)
+            options.debounce_ms = std::max(0, std::atoi(token.c_str() + 9));
+        else if (token.compare(0, 6, "limit=") == 0)
+        {
+            // COUNT or COUNT/SECONDS
+            const char *slash = std::strchr(token.c_str(), '/');
+            options.limit_count = std::max(0, std::atoi(token.c_str() + 6));
+            options.limit_seconds = slash ? std::atof(slash + 1) : 1.0;
+            if (options.limit_seconds <= 0.0)
+            {
+                error = "expected 'limit=COUNT[/SECONDS]'";
+                return false;
+            }
+        }
+        else if (token == "coalesce")
+            options.coalesce = true;
+        else
+        {
+            fields.seekg(start);
+            std::getline(fields, text);
+            break;
+        }
+    }
+
+    if (text.empty())
+    {
+        error = "missing command";
+        return false;
+    }
+
+    // What a sequence runs has nothing to recognise or stream, only to
+    // throttle
+    CommandOptions sequence_options;
+    sequence_options.drop_if_running = options.drop_if_running;
+    sequence_options.debounce_ms = options.debounce_ms;
+    sequence_options.limit_count = options.limit_count;
+    sequence_options.limit_seconds = options.limit_seconds;
+    sequence_options.coalesce = options.coalesce;
+    if (sequence && options != sequence_options)
+    {
+        error = "only 'drop', 'debounce=', 'limit=', 'coalesce' and 'within=' apply to a sequence";
+        return false;
+    }
+    if (window_ms >= 0 && !sequence)
+    {
+        error = "'within=' only applies to a sequence";
+        return false;
+    }
+    if (window_ms == 0)
+    {
+        error = "'within=' needs a number of milliseconds";
+        return false;
+    }
+
+    binding.window_ms = window_ms > 0 ? (uint32_t)window_ms : SEQUENCE_WINDOW_MS;
+    binding.command = std::make_shared<Command>(text, options);
+    return true;
+}
+
+// The options a sequence can have too
+static void format_throttles(std::ostringstream &out, const CommandOptions &options)
+{
+    if (options.drop_if_running)
+        out << " drop";
+    if (options.debounce_ms > 0)
+        out << " debounce=" << options.debounce_ms;
+    if (options.limit_count > 0)
+    {
+        out << " limit=" << options.limit_count;
+        if (options.limit_seconds != 1.0)
+            out << "/" << options.limit_seconds;
+    }
+    if (options.coalesce)
+        out << " coalesce";
+}
+
+static void format_gesture(std::ostringstream &out, GestureKey key)
+{
+    out << gesture_kind_name(gesture_kind(key)) << " " << gesture_fingers(key) << " " << gesture_variant_name(key);
+}
+
+std::string format_binding(GestureKey key, const Command &command)
+{
+    std::ostringstream out;
+    format_gesture(out, key);
+
+    const CommandOptions &options = command.options;
+    const CommandOptions defaults;
+    format_throttles(out, options);
+    if (options.early_distance > 0.0)
+        out << " early=" << options.early_distance;
+    if (options.cancel_if_reversed)
+        out << " cancel";
+    if (options.stream)
+        out << " stream";
+    if (options.stream_step != defaults.stream_step)
+        out << " step=" << options.stream_step;
+    if (options.stream_rate != defaults.stream_rate)
+        out << " rate=" << options.stream_rate;
+
+    out << " " << command.text;
+    return out.str();
+}
+
+std::string format_sequence(const SequenceBinding &sequence)
+{
+    std::ostringstream out;
+    for (size_t i = 0; i < sequence.keys.size(); ++i)
+    {
+        if (i)
+            out << ", ";
+        format_gesture(out, sequence.keys[i]);
+    }
+    format_throttles(out, sequence.command->options);
+    if (sequence.window_ms != SEQUENCE_WINDOW_MS)
+        out << " within=" << sequence.window_ms;
+    out << " " << sequence.command->text;
+    return out.str();
+}
+
+bool load_bindings(const std::string &path, BindingTable &bindings)
+{
+    std::ifstream in(path);
+    if (!in)
+        return false;
+
+    std::string line;
+    int line_no = 0;
+    BindingSlots *slots = &bindings.slots;
+    std::vector<SequenceBinding> *sequences = &bindings.sequences;
+    while (std::getline(in, line))
+    {
+        ++line_no;
+        size_t first = line.find_first_not_of(" \t");
+        if (first == std::string::npos || line[first] == '#')
+            continue;
+
+        if (line[first] == '[')
+        {
+            size_t end = line.find(']', first);
+            std::string app = end == std::string::npos ? std::string() : line.substr(first + 1, end - first - 1);
+            if (app.empty())
+            {
+                LOG(Warn) << path << ":" << line_no << ": expected '[application]'";
+                continue;
+            }
+            BindingProfile &profile = bindings.profile(app);
+            slots = &profile.slots;
+            sequences = &profile.sequences;
+            continue;
+        }
+
+        SequenceBinding binding;
+        std::string error;
+        if (!parse_binding(line, binding, error))
+        {
+            LOG(Warn) << path << ":" << line_no << ": " << error;
+            continue;
+        }
+        if (binding.keys.size() == 1)
+            (*slots)[binding.keys[0]] = std::move(binding.command);
+        else
+            set_sequence(*sequences, std::move(binding));
+    }
+
+    bindings.compile_sequences();
+    return true;
+}
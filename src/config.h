@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "bindings.h"
+
+// Plain-text binding file, one binding per line:
+//
+//     [kind] <fingers> <variant> [options...] <command...>
+//
+// where kind and variant are one of
+//     swipe   LEFT|RIGHT|UP|DOWN   (the default kind)
+//     pinch   IN|OUT
+//     hold    SHORT|LONG
+//     scroll  LEFT|RIGHT|UP|DOWN
+//
+// Options map onto CommandOptions:
+//     drop        drop if still running
+//     early=DIST  fire mid-swipe after DIST millimetres
+//     cancel      cancel if the swipe is reversed
+//     stream      stream motion to the command (or "unix:PATH") instead
+//     step=DIST   motion per streamed step, in mm (percent for pinches)
+//     rate=HZ     most stream writes per second (0 = unlimited)
+//     debounce=MS     don't run again within MS of the last run
+//     limit=N[/SECS]  at most N runs per SECS (default 1), in a token bucket
+//     coalesce        hold back only the latest trigger while running
+//
+// Several gestures separated by commas make a sequence, which runs its
+// command once they have all been recognised in order, each within a window
+// of the one before (SequenceBinding):
+//
+//     swipe 3 UP, swipe 3 LEFT within=400 <command...>
+//     hold 3 SHORT, swipe 3 RIGHT <command...>
+//
+// A sequence takes only drop, debounce=, limit=, coalesce and within=MS
+// (default SEQUENCE_WINDOW_MS).
+// The gestures in it still run their own bindings, if any, as they come.
+//
+// A line "[app]" starts a profile: the bindings after it apply only while
+// a window whose WM_CLASS is app has the focus, in place of the global ones
+// (those before the first profile) for the same gesture.
+//
+// Blank lines and lines starting with '#' are ignored.
+
+// $XDG_CONFIG_HOME/gesture-daemon, or ~/.config/gesture-daemon without it
+std::string config_dir();
+
+// <config_dir>/bindings.conf
+std::string default_config_path();
+
+// Returns false if the file can't be opened. Malformed lines are reported
+// on stderr and skipped.
+bool load_bindings(const std::string &path, BindingTable &bindings);
+
+// One binding line as above, without comments; a plain binding comes back
+// as a sequence of one gesture. On failure error says what was wrong.
+bool parse_binding(const std::string &line, SequenceBinding &binding, std::string &error);
+
+// "[kind] <fingers> <variant>[, ...]" alone
+bool parse_gestures(const std::string &text, std::vector<GestureKey> &keys);
+
+// The line parse_binding reads back into the same binding, kind included
+std::string format_binding(GestureKey key, const Command &command);
+std::string format_sequence(const SequenceBinding &sequence);
@@ -0,0 +1,189 @@
+#include "config_watcher.h"
+
+#include "binding_store.h"
+#include "config.h"
+#include "log.h"
+
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <memory>
+
+// Long enough for an editor to finish writing, short enough to feel instant
+static const uint64_t SETTLE_NS = 100000000ull;
+
+// The same for the directory and for its parents: a created or renamed entry
+// may be the file or the next directory down, and the watched directory
+// itself going away means falling back to its parent
+static const uint32_t WATCH_EVENTS = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE_SELF | IN_MOVE_SELF;
+
+ConfigWatcher::ConfigWatcher(Snapshot<BindingTable> &bindings, std::string path, bool is_store)
+    : bindings_(bindings), path_(std::move(path)), is_store_(is_store)
+{
+    size_t slash = path_.rfind('/');
+    name_ = slash == std::string::npos ? path_ : path_.substr(slash + 1);
+    dir_ = slash == std::string::npos ? "." : slash == 0 ? "/" : path_.substr(0, slash);
+}
+
+ConfigWatcher::~ConfigWatcher()
+{
+    stop();
+}
+
+bool ConfigWatcher::start()
+{
+    inotify_fd_ = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (inotify_fd_ < 0)
+    {
+        LOG(Error) << "Failed to create inotify instance: " << std::strerror(errno);
+        return false;
+    }
+    if (!watch_nearest())
+    {
+        stop();
+        return false;
+    }
+
+    if (!reactor_.open() ||
+        !reactor_.add(inotify_fd_, EPOLLIN, [this](uint32_t) { read_changes(); }) ||
+        (settle_timer_ = reactor_.add_timer([this] { reload(); })) < 0)
+    {
+        stop();
+        return false;
+    }
+
+    thread_ = std::thread([this] { reactor_.run(); });
+    LOG(Info) << "Watching " << path_ << " for changes";
+    return true;
+}
+
+void ConfigWatcher::stop()
+{
+    if (thread_.joinable())
+    {
+        reactor_.stop();
+        thread_.join();
+    }
+    reactor_.close();
+    settle_timer_ = -1;
+    if (inotify_fd_ >= 0)
+    {
+        close(inotify_fd_);
+        inotify_fd_ = -1;
+    }
+    watch_ = -1;
+    watched_.clear();
+}
+
+// Watches dir_, or the closest parent of it that exists. False only if not
+// even that can be watched.
+bool ConfigWatcher::watch_nearest()
+{
+    std::string dir, missing;
+    int watch;
+    do
+    {
+        dir = dir_;
+        while ((watch = inotify_add_watch(inotify_fd_, dir.c_str(), WATCH_EVENTS)) < 0 &&
+               (errno == ENOENT || errno == ENOTDIR) && dir != "/" && dir != ".")
+        {
+            missing = dir;
+            size_t slash = dir.rfind('/');
+            dir = slash == std::string::npos ? "." : slash == 0 ? "/" : dir.substr(0, slash);
+        }
+        if (watch < 0)
+        {
+            LOG(Warn) << "Not watching " << path_ << " for changes: " << std::strerror(errno);
+            return false;
+        }
+        // Created before the parent's watch was in place, so no event is
+        // coming for it
+    } while (dir != dir_ && access(missing.c_str(), F_OK) == 0);
+
+    // The same directory gives back the same watch
+    if (watch_ >= 0 && watch_ != watch)
+        inotify_rm_watch(inotify_fd_, watch_);
+    if (dir != watched_ && dir != dir_)
+        LOG(Info) << dir_ << " doesn't exist yet, watching " << dir << " for it";
+    watch_ = watch;
+    watched_ = dir;
+    return true;
+}
+
+void ConfigWatcher::read_changes()
+{
+    alignas(struct inotify_event) char buffer[4096];
+    bool changed = false;
+    bool rewatch = false;
+    while (true)
+    {
+        ssize_t n = read(inotify_fd_, buffer, sizeof(buffer));
+        if (n <= 0)
+            break;
+
+        for (char *p = buffer; p < buffer + n;)
+        {
+            const struct inotify_event *event = (const struct inotify_event *)p;
+            // Not for a watch that watch_nearest() has since replaced
+            bool current = event->wd == watch_;
+            if (current && (watched_ != dir_ || (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF))))
+                rewatch = true;
+            else if (current && event->len && name_ == event->name)
+                changed = true;
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+
+    // Closer to dir_ or further from it; the file may have come with it
+    if (rewatch)
+    {
+        bool was_there = watched_ == dir_;
+        if (!watch_nearest())
+            return;
+        if (!was_there && watched_ == dir_ && access(path_.c_str(), F_OK) == 0)
+            changed = true;
+    }
+
+    // Every change restarts the wait
+    if (changed)
+        reactor_.arm_timer(settle_timer_, SETTLE_NS);
+}
+
+void ConfigWatcher::reload()
+{
+    auto table = std::make_unique<BindingTable>();
+    bool loaded;
+    if (is_store_)
+    {
+        BindingConfig config;
+        loaded = load_binding_store(path_, config);
+        if (loaded)
+            *table = config.bindings;
+    }
+    else
+    {
+        loaded = load_bindings(path_, *table);
+    }
+
+    // Half-written or deleted; keep what we have until the next change
+    if (!loaded)
+    {
+        LOG(Warn) << "Failed to reload " << path_ << ", keeping the current bindings";
+        return;
+    }
+
+    // The file is the whole truth: bindings made over the control socket
+    // since, saved or not, are replaced along with everything else. A socket
+    // edit serialised after this applies to the new table. Bindings the file
+    // still has unchanged keep their Command, and with it their throttling.
+    size_t count = table->bound_count();
+    bindings_.update([&](BindingTable &current) {
+        table->keep_commands(current);
+        current = std::move(*table);
+        return true;
+    });
+    LOG(Info) << "Reloaded " << count << " binding(s) from " << path_;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <thread>
+
+#include "bindings.h"
+#include "reactor.h"
+#include "snapshot.h"
+
+// Reloads the bindings whenever their file changes, on a thread of its own
+// so parsing never happens on the input thread. The new table is built
+// completely and then published through the binding Snapshot like any other
+// edit; the input thread sees either the old table or the new one at its
+// next read(), without taking a lock.
+//
+// The file's directory is watched rather than the file itself, so editors
+// that save by renaming a new file over the old one are followed, as is the
+// file being created. While the directory doesn't exist its nearest existing
+// parent is watched instead, one level deeper each time the next one is
+// created. A burst of changes is reloaded once, after it settles.
+//
+// A reload replaces the whole table, including bindings made over the
+// control socket since the last one.
+class ConfigWatcher {
+public:
+    // is_store selects the binary binding store format over bindings.conf
+    ConfigWatcher(Snapshot<BindingTable> &bindings, std::string path, bool is_store);
+    ~ConfigWatcher();
+
+    ConfigWatcher(const ConfigWatcher &) = delete;
+    ConfigWatcher &operator=(const ConfigWatcher &) = delete;
+
+    bool start();
+    void stop();
+
+private:
+    bool watch_nearest();
+    void read_changes();
+    void reload();
+
+    Snapshot<BindingTable> &bindings_;
+    std::string path_;
+    std::string dir_;       // path_'s directory
+    std::string name_;      // path_ within it
+    bool is_store_;
+
+    Reactor reactor_;
+    int inotify_fd_ = -1;
+    int watch_ = -1;
+    std::string watched_;   // dir_, or the nearest parent of it that exists
+    int settle_timer_ = -1;
+    std::thread thread_;
+};
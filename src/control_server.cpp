@@ -0,0 +1,738 @@
+#include "control_server.h"
+
+#include "binding_store.h"
+#include "config.h"
+#include "input_thread.h"
+#include "log.h"
+#include "metrics.h"
+#include "stats.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+static const size_t MAX_CLIENTS = 64;
+
+// A command line longer than this hangs the client up
+static const size_t MAX_LINE = 4096;
+
+// Replies are small; a client that lets this much pile up isn't reading
+static const size_t MAX_PENDING_OUTPUT = 1 << 20;
+
+std::string default_control_path()
+{
+    const char *runtime_dir = std::getenv("XDG_RUNTIME_DIR");
+    if (!runtime_dir || !*runtime_dir)
+        return std::string();
+    return std::string(runtime_dir) + "/gesture-daemon.sock";
+}
+
+// Splits an optional leading "[app]" off a bind or unbind argument; app is
+// left empty for a global binding. False if the brackets aren't closed.
+static bool split_profile(const std::string &args, std::string &app, std::string &rest)
+{
+    size_t first = args.find_first_not_of(" \t");
+    if (first == std::string::npos || args[first] != '[')
+    {
+        app.clear();
+        rest = args;
+        return true;
+    }
+
+    size_t end = args.find(']', first);
+    if (end == std::string::npos || end == first + 1)
+        return false;
+    app = args.substr(first + 1, end - first - 1);
+    rest = args.substr(end + 1);
+    return true;
+}
+
+// Anyone who can connect can run commands as us, so the socket is created
+// 0600 rather than chmod()ed after bind(), which would leave a window in
+// which it is open to everyone. Saves errno for the caller.
+static int bind_private(int fd, const struct sockaddr_un &addr)
+{
+    mode_t mask = umask(0177);
+    int ret = ::bind(fd, (const struct sockaddr *)&addr, sizeof(addr));
+    int saved = errno;
+    umask(mask);
+    errno = saved;
+    return ret;
+}
+
+// Only our own user, even if the socket's directory lets others in
+static bool same_user(int fd)
+{
+    struct ucred cred = {};
+    socklen_t length = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &length) != 0)
+        return false;
+    return cred.uid == getuid();
+}
+
+ControlServer::ControlServer(Snapshot<BindingTable> &bindings, Executor &executor, std::string store_path,
+                             std::vector<std::string> user_commands)
+    : bindings_(bindings),
+      executor_(executor),
+      store_path_(std::move(store_path)),
+      user_commands_(std::move(user_commands))
+{
+}
+
+ControlServer::~ControlServer()
+{
+    close();
+}
+
+bool ControlServer::open(const std::string &path)
+{
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path))
+    {
+        LOG(Error) << "Invalid control socket path: " << path;
+        return false;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (listen_fd_ < 0)
+    {
+        LOG(Error) << "Failed to create control socket: " << std::strerror(errno);
+        return false;
+    }
+
+    int ret = bind_private(listen_fd_, addr);
+    if (ret != 0 && errno == EADDRINUSE)
+    {
+        // Only take the path over if nobody answers on it
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        bool live = probe >= 0 && connect(probe, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+        if (probe >= 0)
+            ::close(probe);
+        if (live)
+        {
+            LOG(Error) << "Control socket " << path << " is in use by another daemon";
+            close();
+            return false;
+        }
+        unlink(path.c_str());
+        ret = bind_private(listen_fd_, addr);
+    }
+    if (ret != 0)
+    {
+        LOG(Error) << "Failed to bind control socket " << path << ": " << std::strerror(errno);
+        close();
+        return false;
+    }
+    path_ = path;
+
+    if (listen(listen_fd_, 16) != 0)
+    {
+        LOG(Error) << "Failed to listen on control socket " << path << ": " << std::strerror(errno);
+        close();
+        return false;
+    }
+
+    LOG(Info) << "Control socket listening on " << path;
+    return true;
+}
+
+void ControlServer::close()
+{
+    while (!clients_.empty())
+        remove_client(clients_.size() - 1);
+    detach();
+    if (listen_fd_ >= 0)
+    {
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+    }
+    if (!path_.empty())
+    {
+        unlink(path_.c_str());
+        path_.clear();
+    }
+}
+
+static void drain_eventfd(int fd)
+{
+    uint64_t count;
+    ssize_t ret = read(fd, &count, sizeof(count));
+    (void)ret;
+}
+
+static void signal_eventfd(int fd)
+{
+    uint64_t one = 1;
+    ssize_t ret = write(fd, &one, sizeof(one));
+    (void)ret;
+}
+
+bool ControlServer::attach(Reactor &reactor, const GestureStatus &status)
+{
+    reactor_ = &reactor;
+    status_ = &status;
+
+    request_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    reply_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (request_fd_ < 0 || reply_fd_ < 0)
+    {
+        LOG(Error) << "Failed to create eventfd: " << std::strerror(errno);
+        detach();
+        return false;
+    }
+    if (!worker_.open() ||
+        !worker_.add(request_fd_, EPOLLIN, [this](uint32_t) { run_requests(); }) ||
+        !reactor.add(reply_fd_, EPOLLIN, [this](uint32_t) { read_replies(); }) ||
+        !reactor.add(listen_fd_, EPOLLIN, [this](uint32_t) { accept_clients(); }))
+    {
+        detach();
+        return false;
+    }
+
+    worker_thread_ = std::thread([this] { worker_.run(); });
+    // set_user_commands() may have queued something already
+    signal_eventfd(request_fd_);
+    return true;
+}
+
+void ControlServer::detach()
+{
+    if (!reactor_)
+        return;
+
+    // Lets a save that has started finish
+    if (worker_thread_.joinable())
+    {
+        worker_.stop();
+        worker_thread_.join();
+    }
+    worker_.close();
+
+    reactor_->remove(listen_fd_);
+    for (const Client &client : clients_)
+        reactor_->remove(client.fd);
+    if (reply_fd_ >= 0)
+    {
+        reactor_->remove(reply_fd_);
+        ::close(reply_fd_);
+        reply_fd_ = -1;
+    }
+    if (request_fd_ >= 0)
+    {
+        ::close(request_fd_);
+        request_fd_ = -1;
+    }
+    reactor_ = nullptr;
+    status_ = nullptr;
+}
+
+void ControlServer::set_user_commands(std::vector<std::string> user_commands)
+{
+    Request request;
+    request.kind = Request::UserCommands;
+    request.client = 0;
+    request.user_commands = std::move(user_commands);
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        requests_.push_back(std::move(request));
+    }
+    if (request_fd_ >= 0)
+        signal_eventfd(request_fd_);
+}
+
+void ControlServer::handle_client(int fd, uint32_t events)
+{
+    size_t index = find_client(fd);
+    if (index == clients_.size())
+        return;
+
+    Client &client = clients_[index];
+    if (events & (EPOLLERR | EPOLLHUP))
+    {
+        remove_client(index);
+        return;
+    }
+    if (events & EPOLLIN)
+        read_client(client);
+    finish_client(index);
+}
+
+// Sends what is ready, then hangs up or waits for more
+void ControlServer::finish_client(size_t index)
+{
+    Client &client = clients_[index];
+    if (!client.out.empty())
+        write_client(client);
+
+    if (client.out.size() > MAX_PENDING_OUTPUT || (client.closing && client.out.empty() && !client.waiting))
+        remove_client(index);
+    else
+        update_events(client);
+}
+
+void ControlServer::accept_clients()
+{
+    while (true)
+    {
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+        if (fd < 0)
+            return;
+
+        if (!same_user(fd))
+        {
+            LOG_LIMITED(Warn, 5) << "Refused a control client running as another user";
+            ::close(fd);
+            continue;
+        }
+
+        if (clients_.size() >= MAX_CLIENTS)
+        {
+            static const char full[] = "error too many clients\n";
+            ssize_t ret = send(fd, full, sizeof(full) - 1, MSG_NOSIGNAL);
+            (void)ret;
+            ::close(fd);
+            continue;
+        }
+
+        if (!reactor_->add(fd, EPOLLIN, [this, fd](uint32_t events) { handle_client(fd, events); }))
+        {
+            ::close(fd);
+            continue;
+        }
+
+        Client client;
+        client.fd = fd;
+        client.id = next_client_id_++;
+        // Room for the odd partial event line, so publish() doesn't allocate
+        client.out.reserve(4096);
+        clients_.push_back(std::move(client));
+    }
+}
+
+void ControlServer::read_client(Client &client)
+{
+    char buffer[4096];
+    while (true)
+    {
+        ssize_t n = recv(client.fd, buffer, sizeof(buffer), 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            break;
+        if (n == 0)
+        {
+            // Still answer what was sent before the client shut its side
+            client.closing = true;
+            break;
+        }
+        client.in.append(buffer, (size_t)n);
+    }
+    handle_lines(client);
+}
+
+// Stops at a command handed to the worker; the rest waits for its reply
+void ControlServer::handle_lines(Client &client)
+{
+    size_t start = 0;
+    size_t end;
+    while (!client.waiting && (end = client.in.find('\n', start)) != std::string::npos)
+    {
+        handle_line(client, client.in.substr(start, end - start));
+        start = end + 1;
+    }
+    client.in.erase(0, start);
+
+    if (!client.waiting && client.in.size() > MAX_LINE)
+    {
+        reply(client, "error line too long");
+        client.in.clear();
+        client.closing = true;
+    }
+}
+
+void ControlServer::handle_line(Client &client, const std::string &line)
+{
+    size_t first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos || line[first] == '#')
+        return;
+    std::string text = line.substr(first, line.find_last_not_of(" \t\r") + 1 - first);
+
+    // The command name, then everything after it as one argument string
+    size_t split = text.find_first_of(" \t");
+    std::string name = text.substr(0, split);
+    std::string args;
+    if (split != std::string::npos)
+        args = text.substr(text.find_first_not_of(" \t", split));
+
+    if (name == "list")
+        list(client);
+    else if (name == "bind")
+        queue(client, Request::Bind, args);
+    else if (name == "unbind")
+        queue(client, Request::Unbind, args);
+    else if (name == "save")
+        queue(client, Request::Save, args);
+    else if (name == "stats")
+        stats(client);
+    else if (name == "metrics")
+        metrics(client);
+    else if (name == "gui")
+        gui(client);
+    else if (name == "subscribe" || name == "unsubscribe")
+    {
+        client.subscribed = name == "subscribe";
+        reply(client, "ok");
+    }
+    else
+        reply(client, "error unknown command: " + name);
+}
+
+void ControlServer::reply(Client &client, const std::string &text)
+{
+    client.out += text;
+    client.out += '\n';
+}
+
+void ControlServer::write_client(Client &client)
+{
+    size_t done = 0;
+    while (done < client.out.size())
+    {
+        ssize_t n = send(client.fd, client.out.data() + done, client.out.size() - done, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (n < 0)
+        {
+            // Hung up; handle_client() removes it once out is empty
+            client.out.clear();
+            client.closing = true;
+            return;
+        }
+        done += (size_t)n;
+    }
+    client.out.erase(0, done);
+}
+
+void ControlServer::update_events(Client &client)
+{
+    // Unread commands are left in the socket while one is with the worker
+    uint32_t events = 0;
+    if (!client.closing && !client.waiting)
+        events |= EPOLLIN;
+    if (!client.out.empty())
+        events |= EPOLLOUT;
+    reactor_->modify(client.fd, events);
+}
+
+void ControlServer::remove_client(size_t index)
+{
+    if (reactor_)
+        reactor_->remove(clients_[index].fd);
+    ::close(clients_[index].fd);
+    if (index != clients_.size() - 1)
+        clients_[index] = std::move(clients_.back());
+    clients_.pop_back();
+}
+
+size_t ControlServer::find_client(int fd) const
+{
+    for (size_t i = 0; i < clients_.size(); ++i)
+    {
+        if (clients_[i].fd == fd)
+            return i;
+    }
+    return clients_.size();
+}
+
+// Queued behind a pending reply, or sent straight away when there is
+// none. Returns false if there was no room without allocating.
+bool ControlServer::send_line(Client &client, const char *line, size_t length)
+{
+    if (!client.out.empty())
+    {
+        if (client.out.size() + length > client.out.capacity())
+            return false;
+        client.out.append(line, length);
+        return true;
+    }
+
+    // A hung up client is removed by handle_client() on EPOLLHUP
+    ssize_t n = send(client.fd, line, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (n < 0)
+        return false;
+    if ((size_t)n < length)
+    {
+        client.out.append(line + n, length - (size_t)n);
+        update_events(client);
+    }
+    return true;
+}
+
+void ControlServer::publish(GestureKey key, bool bound)
+{
+    char line[96];
+    for (Client &client : clients_)
+    {
+        if (!client.subscribed || client.closing)
+            continue;
+
+        if (client.dropped)
+        {
+            int n = std::snprintf(line, sizeof(line), "dropped %llu\n", (unsigned long long)client.dropped);
+            if (!send_line(client, line, (size_t)n))
+            {
+                client.dropped++;
+                continue;
+            }
+            client.dropped = 0;
+        }
+
+        int n = std::snprintf(line, sizeof(line), "gesture %s %d %s %s\n", gesture_kind_name(gesture_kind(key)),
+                              gesture_fingers(key), gesture_variant_name(key), bound ? "bound" : "unbound");
+        if (!send_line(client, line, (size_t)n))
+            client.dropped++;
+    }
+}
+
+void ControlServer::list(Client &client)
+{
+    const BindingTable &table = *bindings_.read();
+    for (size_t key = 0; key < GESTURE_KEY_COUNT; ++key)
+    {
+        if (table.slots[key])
+            reply(client, "binding " + format_binding((GestureKey)key, *table.slots[key]));
+    }
+    for (const SequenceBinding &sequence : table.sequences)
+        reply(client, "binding " + format_sequence(sequence));
+    for (const BindingProfile &profile : table.profiles)
+    {
+        for (size_t key = 0; key < GESTURE_KEY_COUNT; ++key)
+        {
+            if (profile.slots[key])
+                reply(client, "binding [" + profile.app + "] " + format_binding((GestureKey)key, *profile.slots[key]));
+        }
+        for (const SequenceBinding &sequence : profile.sequences)
+            reply(client, "binding [" + profile.app + "] " + format_sequence(sequence));
+    }
+    reply(client, "ok");
+}
+
+void ControlServer::queue(Client &client, Request::Kind kind, const std::string &args)
+{
+    // Checked again by the worker, in case the GUI opens in between
+    if (read_only_.load(std::memory_order_acquire))
+    {
+        reply(client, "error bindings are managed by the GUI");
+        return;
+    }
+
+    Request request;
+    request.kind = kind;
+    request.client = client.id;
+    request.args = args;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        requests_.push_back(std::move(request));
+    }
+    signal_eventfd(request_fd_);
+    client.waiting = true;
+}
+
+void ControlServer::read_replies()
+{
+    drain_eventfd(reply_fd_);
+    std::vector<Reply> replies;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        replies.swap(replies_);
+    }
+
+    for (Reply &done : replies)
+    {
+        // Gone if it hung up in the meantime
+        size_t index = 0;
+        while (index < clients_.size() && clients_[index].id != done.client)
+            ++index;
+        if (index == clients_.size())
+            continue;
+
+        Client &client = clients_[index];
+        client.waiting = false;
+        reply(client, done.text);
+        handle_lines(client);
+        finish_client(index);
+    }
+}
+
+void ControlServer::run_requests()
+{
+    drain_eventfd(request_fd_);
+    std::vector<Request> requests;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        requests.swap(requests_);
+    }
+
+    for (Request &request : requests)
+    {
+        std::string text;
+        switch (request.kind)
+        {
+        case Request::Bind:
+            text = bind(request.args);
+            break;
+        case Request::Unbind:
+            text = unbind(request.args);
+            break;
+        case Request::Save:
+            text = save();
+            break;
+        case Request::UserCommands:
+            user_commands_ = std::move(request.user_commands);
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            replies_.push_back({request.client, std::move(text)});
+        }
+        signal_eventfd(reply_fd_);
+    }
+}
+
+std::string ControlServer::bind(const std::string &args)
+{
+    if (read_only_.load(std::memory_order_acquire))
+        return "error bindings are managed by the GUI";
+
+    std::string app, line;
+    if (!split_profile(args, app, line))
+        return "error expected '[application]'";
+
+    SequenceBinding binding;
+    std::string error;
+    if (!parse_binding(line, binding, error))
+        return "error " + error;
+    if (!binding.command->valid())
+        return "error invalid action: " + binding.command->text;
+
+    // Against whatever table is current by then, e.g. one a reload published
+    // Binding what is already there keeps its throttling
+    bindings_.update([&](BindingTable &table) {
+        BindingTable previous = table;
+        BindingProfile *profile = app.empty() ? nullptr : &table.profile(app);
+        if (binding.keys.size() == 1)
+            (profile ? profile->slots : table.slots)[binding.keys[0]] = std::move(binding.command);
+        else
+            set_sequence(profile ? profile->sequences : table.sequences, std::move(binding));
+        table.keep_commands(previous);
+        return true;
+    });
+
+    LOG(Info) << "Bound over control socket: " << args;
+    return "ok";
+}
+
+std::string ControlServer::unbind(const std::string &args)
+{
+    if (read_only_.load(std::memory_order_acquire))
+        return "error bindings are managed by the GUI";
+
+    std::string app, gesture;
+    std::vector<GestureKey> keys;
+    if (!split_profile(args, app, gesture) || !parse_gestures(gesture, keys))
+        return "error expected '[application] [kind] <fingers> <variant>[, ...]'";
+
+    bool found = bindings_.update([&](BindingTable &table) {
+        int profile = app.empty() ? -1 : table.find_profile(app.c_str(), nullptr);
+        if (profile < 0 && !app.empty())
+            return false;
+        if (keys.size() == 1)
+        {
+            CommandRef &slot = (profile < 0 ? table.slots : table.profiles[profile].slots)[keys[0]];
+            bool bound = slot != nullptr;
+            slot = nullptr;
+            return bound;
+        }
+        if (!erase_sequence(profile < 0 ? table.sequences : table.profiles[profile].sequences, keys))
+            return false;
+        table.compile_sequences();
+        return true;
+    });
+    if (!found)
+        return "error not bound: " + args;
+
+    LOG(Info) << "Unbound over control socket: " << args;
+    return "ok";
+}
+
+std::string ControlServer::save()
+{
+    if (read_only_.load(std::memory_order_acquire))
+        return "error bindings are managed by the GUI";
+
+    if (!save_binding_store(store_path_, {*bindings_.copy(), user_commands_}))
+        return "error failed to write " + store_path_;
+    return "ok";
+}
+
+void ControlServer::stats(Client &client)
+{
+    const GestureStatus &status = *status_;
+    const BindingTable &table = *bindings_.read();
+    char line[256];
+    std::snprintf(line, sizeof(line),
+                  "status events=%llu devices=%d gestures=%llu coalesced=%llu running=%d bindings=%zu version=%llu",
+                  (unsigned long long)status.events, status.devices, (unsigned long long)status.gestures,
+                  (unsigned long long)status.coalesced, executor_.running(), table.bound_count(),
+                  (unsigned long long)table.version);
+    reply(client, line);
+
+    for (size_t i = 0; i < PIPELINE_STATS_ENTRY_COUNT; ++i)
+    {
+        LatencyHistogram::Summary s = PIPELINE_STATS_ENTRIES[i].histogram->summary();
+        std::snprintf(line, sizeof(line), "latency %s count=%llu p50=%.1f p90=%.1f p99=%.1f max=%.1f",
+                      PIPELINE_STATS_ENTRIES[i].name, (unsigned long long)s.count,
+                      s.p50 / 1000.0, s.p90 / 1000.0, s.p99 / 1000.0, s.max / 1000.0);
+        reply(client, line);
+    }
+    reply(client, "ok");
+}
+
+// The lines end with "# EOF", then the usual "ok"
+void ControlServer::metrics(Client &client)
+{
+    format_openmetrics(client.out);
+    reply(client, "ok");
+}
+
+// Only asks; the main thread opens the window, or ignores it if it's open
+void ControlServer::gui(Client &client)
+{
+    if (gui_fd_ < 0)
+    {
+        reply(client, "error no GUI in this build");
+        return;
+    }
+
+    uint64_t one = 1;
+    if (write(gui_fd_, &one, sizeof(one)) != sizeof(one))
+    {
+        reply(client, std::string("error ") + std::strerror(errno));
+        return;
+    }
+    reply(client, "ok");
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bindings.h"
+#include "executor.h"
+#include "gesture.h"
+#include "reactor.h"
+#include "snapshot.h"
+
+struct GestureStatus;
+
+// Control socket for managing a running daemon without the GUI. Clients
+// connect to a Unix stream socket and send one command per line; each
+// reply is zero or more data lines followed by "ok" or "error MESSAGE":
+//
+//     list                   "binding <line>" for every bound gesture or sequence
+//     bind <line>            binds a gesture or sequence, in bindings.conf syntax
+//     unbind <gesture>       "[kind] <fingers> <variant>[, ...]"
+//     save                   writes the bindings to the binding store
+//     gui                    opens the configuration window
+//     stats                  "status ..." and one "latency ..." per stage
+//     metrics                every counter, in the OpenMetrics text format
+//     subscribe              "gesture <kind> <fingers> <variant> bound|unbound"
+//     unsubscribe            for every gesture recognised from now on
+//
+// bind and unbind take an optional leading "[application]" for the
+// binding in that application's profile; list prefixes those the same way.
+//
+// The listening socket and clients are registered with the input thread's
+// Reactor, next to libinput, so reading commands and answering them runs on
+// that thread, which is also the binding snapshot's reader. bind, unbind and
+// save are handed to a worker thread instead: parsing a command looks it up
+// on PATH and saving fsyncs the store, neither of which gesture handling
+// should wait behind. The worker publishes the new table itself and its
+// reply goes back to the input thread through an eventfd; until then that
+// client's further commands wait, so replies keep their order. An edit is
+// applied with Snapshot::update(), so it is never lost to another writer; a
+// later reload of the bindings file replaces it, though, unless it was saved
+// there.
+class ControlServer {
+public:
+    // user_commands are saved along with the bindings, for the GUI
+    ControlServer(Snapshot<BindingTable> &bindings, Executor &executor, std::string store_path,
+                  std::vector<std::string> user_commands);
+    ~ControlServer();
+
+    ControlServer(const ControlServer &) = delete;
+    ControlServer &operator=(const ControlServer &) = delete;
+
+    // Listens on path, replacing a socket left behind by a daemon that is
+    // no longer running
+    bool open(const std::string &path);
+    void close();
+
+    bool is_open() const { return listen_fd_ >= 0; }
+
+    // Starts serving clients from reactor, and the worker thread; stats
+    // report status. Both must stay valid until detach().
+    bool attach(Reactor &reactor, const GestureStatus &status);
+    void detach();
+
+    // Refuse bind, unbind and save, e.g. while the GUI owns the bindings.
+    // Any thread.
+    void set_read_only(bool read_only) { read_only_.store(read_only, std::memory_order_release); }
+
+    // What save writes along with the bindings from now on. From the thread
+    // that attaches; queued for the worker behind any command already waiting.
+    void set_user_commands(std::vector<std::string> user_commands);
+
+    // eventfd the gui command writes to; without one (-1) it is refused.
+    // Set before attach().
+    void set_gui_fd(int fd) { gui_fd_ = fd; }
+
+    // Tells subscribers about a recognised gesture. Doesn't allocate; a
+    // subscriber whose socket is full misses the line, and is told how many
+    // it missed with the next one.
+    void publish(GestureKey key, bool bound);
+
+private:
+    struct Client {
+        int fd = -1;
+        uint64_t id = 0;            // fds are reused; the worker's reply names this
+        bool subscribed = false;
+        bool closing = false;       // hang up once out is written
+        bool waiting = false;       // a command is with the worker
+        uint64_t dropped = 0;       // events missed while the socket was full
+        std::string in;
+        std::string out;
+    };
+
+    // Work for the worker thread, and its answer
+    struct Request {
+        enum Kind { Bind, Unbind, Save, UserCommands } kind;
+        uint64_t client;
+        std::string args;
+        std::vector<std::string> user_commands;
+    };
+    struct Reply {
+        uint64_t client;
+        std::string text;
+    };
+
+    void accept_clients();
+    void handle_client(int fd, uint32_t events);
+    void finish_client(size_t index);
+    void read_client(Client &client);
+    void handle_lines(Client &client);
+    void handle_line(Client &client, const std::string &line);
+    void write_client(Client &client);
+    bool send_line(Client &client, const char *line, size_t length);
+    void reply(Client &client, const std::string &text);
+    void update_events(Client &client);
+    void remove_client(size_t index);
+    size_t find_client(int fd) const;
+
+    void list(Client &client);
+    void queue(Client &client, Request::Kind kind, const std::string &args);
+    void stats(Client &client);
+    void metrics(Client &client);
+    void gui(Client &client);
+
+    // Input thread: replies the worker has finished
+    void read_replies();
+
+    // Worker thread
+    void run_requests();
+    std::string bind(const std::string &args);
+    std::string unbind(const std::string &args);
+    std::string save();
+
+    Snapshot<BindingTable> &bindings_;
+    Executor &executor_;
+    std::string store_path_;
+    std::vector<std::string> user_commands_;    // worker's
+    std::atomic<bool> read_only_{false};
+    int gui_fd_ = -1;
+
+    std::string path_;
+    int listen_fd_ = -1;
+    Reactor *reactor_ = nullptr;
+    const GestureStatus *status_ = nullptr;
+    std::vector<Client> clients_;
+    uint64_t next_client_id_ = 1;
+
+    Reactor worker_;
+    std::thread worker_thread_;
+    int request_fd_ = -1;       // eventfd the worker waits on
+    int reply_fd_ = -1;         // eventfd the input thread waits on
+    std::mutex queue_mutex_;
+    std::vector<Request> requests_;
+    std::vector<Reply> replies_;
+};
+
+// $XDG_RUNTIME_DIR/gesture-daemon.sock, or empty without XDG_RUNTIME_DIR
+std::string default_control_path();
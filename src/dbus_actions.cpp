@@ -0,0 +1,199 @@
+#include "dbus_actions.h"
+
+#include "log.h"
+
+#ifdef HAVE_DBUS
+
+#include <dbus/dbus.h>
+
+// How long to wait for the bus to list players
+static const int LIST_NAMES_TIMEOUT_MS = 200;
+
+static const char MPRIS_PREFIX[] = "org.mpris.MediaPlayer2.";
+
+DbusActions::~DbusActions()
+{
+    if (connection_)
+    {
+        dbus_connection_close(connection_);
+        dbus_connection_unref(connection_);
+    }
+}
+
+bool DbusActions::connect()
+{
+    if (connection_ && dbus_connection_get_is_connected(connection_))
+        return true;
+
+    if (connection_)
+    {
+        dbus_connection_unref(connection_);
+        connection_ = nullptr;
+    }
+
+    DBusError error;
+    dbus_error_init(&error);
+    connection_ = dbus_bus_get_private(DBUS_BUS_SESSION, &error);
+    if (!connection_)
+    {
+        LOG(Error) << "Failed to connect to the session bus: " << error.message;
+        dbus_error_free(&error);
+        return false;
+    }
+
+    // We are a daemon, not a D-Bus client application
+    dbus_connection_set_exit_on_disconnect(connection_, FALSE);
+    return true;
+}
+
+// Sends without waiting for a reply; takes ownership of message
+static bool send(DBusConnection *connection, DBusMessage *message)
+{
+    dbus_message_set_no_reply(message, TRUE);
+    bool ok = dbus_connection_send(connection, message, nullptr);
+    dbus_message_unref(message);
+    dbus_connection_flush(connection);
+    return ok;
+}
+
+bool DbusActions::mpris(const std::string &method, const std::string &player)
+{
+    if (!connect())
+        return false;
+
+    DBusMessage *list = dbus_message_new_method_call("org.freedesktop.DBus", "/org/freedesktop/DBus",
+                                                     "org.freedesktop.DBus", "ListNames");
+    DBusError error;
+    dbus_error_init(&error);
+    DBusMessage *reply = dbus_connection_send_with_reply_and_block(connection_, list, LIST_NAMES_TIMEOUT_MS, &error);
+    dbus_message_unref(list);
+    if (!reply)
+    {
+        LOG(Error) << "Failed to list D-Bus names: " << error.message;
+        dbus_error_free(&error);
+        return false;
+    }
+
+    std::string destination;
+    DBusMessageIter iter, names;
+    if (dbus_message_iter_init(reply, &iter) && dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_ARRAY)
+    {
+        dbus_message_iter_recurse(&iter, &names);
+        while (dbus_message_iter_get_arg_type(&names) == DBUS_TYPE_STRING)
+        {
+            const char *name;
+            dbus_message_iter_get_basic(&names, &name);
+            std::string candidate = name;
+            if (candidate.compare(0, sizeof(MPRIS_PREFIX) - 1, MPRIS_PREFIX) == 0 &&
+                (player.empty() || candidate.find(player, sizeof(MPRIS_PREFIX) - 1) != std::string::npos))
+            {
+                destination = candidate;
+                break;
+            }
+            dbus_message_iter_next(&names);
+        }
+    }
+    dbus_message_unref(reply);
+
+    if (destination.empty())
+    {
+        LOG(Warn) << "No MPRIS player" << (player.empty() ? "" : " matching " + player) << " found";
+        return false;
+    }
+
+    return call(destination, "/org/mpris/MediaPlayer2", "org.mpris.MediaPlayer2.Player", method, {});
+}
+
+bool DbusActions::notify(const std::string &summary)
+{
+    if (!connect())
+        return false;
+
+    DBusMessage *message = dbus_message_new_method_call("org.freedesktop.Notifications", "/org/freedesktop/Notifications",
+                                                        "org.freedesktop.Notifications", "Notify");
+    const char *app_name = "gesture-daemon";
+    dbus_uint32_t replaces_id = 0;
+    const char *icon = "";
+    const char *summary_text = summary.c_str();
+    const char *body = "";
+    dbus_int32_t timeout = -1;
+
+    // Notify(s app_name, u replaces_id, s icon, s summary, s body,
+    //        as actions, a{sv} hints, i timeout)
+    DBusMessageIter iter, array;
+    dbus_message_iter_init_append(message, &iter);
+    dbus_message_iter_append_basic(&iter, DBUS_TYPE_STRING, &app_name);
+    dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT32, &replaces_id);
+    dbus_message_iter_append_basic(&iter, DBUS_TYPE_STRING, &icon);
+    dbus_message_iter_append_basic(&iter, DBUS_TYPE_STRING, &summary_text);
+    dbus_message_iter_append_basic(&iter, DBUS_TYPE_STRING, &body);
+    dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "s", &array);
+    dbus_message_iter_close_container(&iter, &array);
+    dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "{sv}", &array);
+    dbus_message_iter_close_container(&iter, &array);
+    dbus_message_iter_append_basic(&iter, DBUS_TYPE_INT32, &timeout);
+
+    return send(connection_, message);
+}
+
+bool DbusActions::call(const std::string &destination, const std::string &path,
+                       const std::string &interface, const std::string &method,
+                       const std::vector<std::string> &args)
+{
+    if (!connect())
+        return false;
+
+    if (!dbus_validate_bus_name(destination.c_str(), nullptr) || !dbus_validate_path(path.c_str(), nullptr) ||
+        !dbus_validate_interface(interface.c_str(), nullptr) || !dbus_validate_member(method.c_str(), nullptr))
+    {
+        LOG(Error) << "Invalid D-Bus call: " << destination << " " << path << " " << interface << "." << method;
+        return false;
+    }
+
+    DBusMessage *message = dbus_message_new_method_call(destination.c_str(), path.c_str(),
+                                                        interface.c_str(), method.c_str());
+    DBusMessageIter iter;
+    dbus_message_iter_init_append(message, &iter);
+    for (const std::string &arg : args)
+    {
+        const char *value = arg.c_str();
+        dbus_message_iter_append_basic(&iter, DBUS_TYPE_STRING, &value);
+    }
+
+    return send(connection_, message);
+}
+
+#else
+
+DbusActions::~DbusActions()
+{
+}
+
+static bool unsupported()
+{
+    LOG(Error) << "D-Bus actions are not available: built without libdbus";
+    return false;
+}
+
+bool DbusActions::mpris(const std::string &, const std::string &)
+{
+    return unsupported();
+}
+
+bool DbusActions::notify(const std::string &)
+{
+    return unsupported();
+}
+
+bool DbusActions::call(const std::string &, const std::string &, const std::string &, const std::string &,
+                       const std::vector<std::string> &)
+{
+    return unsupported();
+}
+
+bool DbusActions::connect()
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct DBusConnection;
+
+// Session bus connection for built-in D-Bus actions, opened on first use and
+// kept open, so an action is one message rather than a playerctl or
+// notify-send process. Built without HAVE_DBUS, every call just reports that
+// support is missing.
+class DbusActions {
+public:
+    DbusActions() = default;
+    ~DbusActions();
+
+    DbusActions(const DbusActions &) = delete;
+    DbusActions &operator=(const DbusActions &) = delete;
+
+    // Calls METHOD on the org.mpris.MediaPlayer2.Player interface of the
+    // first player whose bus name contains player (any player if empty)
+    bool mpris(const std::string &method, const std::string &player);
+
+    // Shows a desktop notification
+    bool notify(const std::string &summary);
+
+    // Fire-and-forget call with string arguments
+    bool call(const std::string &destination, const std::string &path,
+              const std::string &interface, const std::string &method,
+              const std::vector<std::string> &args);
+
+private:
+    bool connect();
+
+    DBusConnection *connection_ = nullptr;
+};
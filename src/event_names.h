@@ -0,0 +1,50 @@
+#pragma once
+
+#include <libinput.h>
+
+#include <string_view>
+
+// Human-readable event type mapping. Static strings only, so it is safe to
+// call on the event hot path.
+constexpr std::string_view event_type_name(enum libinput_event_type type)
+{
+    switch (type)
+    {
+    case LIBINPUT_EVENT_DEVICE_ADDED:
+        return "DEVICE_ADDED";                      // device connect
+    case LIBINPUT_EVENT_DEVICE_REMOVED:
+        return "DEVICE_REMOVED";                    // device remove
+
+    case LIBINPUT_EVENT_POINTER_MOTION:
+        return "POINTER_MOTION";                    // 1 finger scroll
+    case LIBINPUT_EVENT_POINTER_BUTTON:
+        return "POINTER_BUTTON";                    // buttons
+
+    case LIBINPUT_EVENT_POINTER_AXIS:
+        return "POINTER_AXIS";                      // 2 finger scroll
+    case LIBINPUT_EVENT_POINTER_SCROLL_FINGER:
+        return "POINTER_FINGER";                    // 2 finger scroll
+
+    case LIBINPUT_EVENT_GESTURE_SWIPE_BEGIN:
+        return "GESTURE_SWIPE_BEGIN";               // 3,4 finger scroll
+    case LIBINPUT_EVENT_GESTURE_SWIPE_UPDATE:
+        return "GESTURE_SWIPE_UPDATE";
+    case LIBINPUT_EVENT_GESTURE_SWIPE_END:
+        return "GESTURE_SWIPE_END";
+
+    case LIBINPUT_EVENT_GESTURE_PINCH_BEGIN:
+        return "GESTURE_PINCH_BEGIN";               // 2,3,4 finger zoom
+    case LIBINPUT_EVENT_GESTURE_PINCH_UPDATE:
+        return "GESTURE_PINCH_UPDATE";
+    case LIBINPUT_EVENT_GESTURE_PINCH_END:
+        return "GESTURE_PINCH_END";
+
+    case LIBINPUT_EVENT_GESTURE_HOLD_BEGIN:
+        return "GESTURE_HOLD_BEGIN";               // 1,2 finger tap
+    case LIBINPUT_EVENT_GESTURE_HOLD_END:
+        return "GESTURE_HOLD_END";
+
+    default:
+        return "UNKNOWN_EVENT";
+    }
+}
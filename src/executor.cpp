@@ -0,0 +1,548 @@
+#include "executor.h"
+
+#include "clock.h"
+#include "log.h"
+#include "metrics.h"
+#include "stats.h"
+
+#include <signal.h>
+#include <spawn.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+extern char **environ;
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+static int pidfd_open(pid_t pid)
+{
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+}
+
+// How often to sweep with waitpid(WNOHANG) for children we have no pidfd for
+static const uint64_t FALLBACK_REAP_NS = 100000000ull;
+
+// Runs program with stdin_fd as its stdin if not -1. Returns 0 or an errno
+// value.
+static int spawn_process(const char *program, char *const argv[], int stdin_fd, pid_t &pid)
+{
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+
+    // Children get a clean signal state regardless of what our threads block
+    sigset_t mask;
+    sigemptyset(&mask);
+    posix_spawnattr_setsigmask(&attr, &mask);
+    sigset_t defaults;
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGPIPE);
+    sigaddset(&defaults, SIGCHLD);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (stdin_fd >= 0)
+        posix_spawn_file_actions_adddup2(&actions, stdin_fd, STDIN_FILENO);
+
+    int err = posix_spawn(&pid, program, &actions, &attr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    return err;
+}
+
+static int spawn_shell(const std::string &text, int stdin_fd, pid_t &pid)
+{
+    const char *argv[] = {"sh", "-c", text.c_str(), nullptr};
+    return spawn_process("/bin/sh", const_cast<char *const *>(argv), stdin_fd, pid);
+}
+
+Executor::Executor(int max_concurrent)
+    : max_concurrent_(max_concurrent < 1 ? 1 : max_concurrent)
+{
+}
+
+Executor::~Executor()
+{
+    stop();
+}
+
+bool Executor::start()
+{
+    wake_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wake_fd_ < 0)
+    {
+        LOG(Error) << "Failed to create eventfd: " << std::strerror(errno);
+        return false;
+    }
+
+    if (!reactor_.open())
+        return false;
+    flush_timer_ = reactor_.add_timer([] {});   // only wakes the loop to flush sinks
+    sweep_timer_ = reactor_.add_timer([this] { sweep(); });
+    bool watching = reactor_.add(wake_fd_, EPOLLIN, [this](uint32_t) {
+        uint64_t count;
+        ssize_t ret = read(wake_fd_, &count, sizeof(count));
+        (void)ret;
+        drain_queue();
+        drain_streams();
+    });
+    if (flush_timer_ < 0 || sweep_timer_ < 0 || !watching)
+        return false;
+
+    // Now rather than at the first key action, which would be lost while
+    // the new device is picked up
+    keyboard_.open();
+
+    thread_ = std::thread(&Executor::run, this);
+    return true;
+}
+
+void Executor::stop()
+{
+    if (thread_.joinable())
+    {
+        reactor_.stop();
+        thread_.join();
+    }
+    reactor_.close();
+    if (wake_fd_ >= 0)
+    {
+        close(wake_fd_);
+        wake_fd_ = -1;
+    }
+
+    // Children keep running; we just stop watching them. Sink processes
+    // see EOF on stdin once their sink closes.
+    for (Child &child : children_)
+        close(child.pidfd);
+    for (Child &child : sink_children_)
+        close(child.pidfd);
+    children_.clear();
+    sink_children_.clear();
+    sinks_.clear();
+    pending_.clear();
+}
+
+bool Executor::submit(const CommandRef &command, uint64_t event_time_us)
+{
+    int previous = command->in_flight.fetch_add(1, std::memory_order_acq_rel);
+    if (command->options.drop_if_running && previous > 0)
+    {
+        command->in_flight.fetch_sub(1, std::memory_order_acq_rel);
+        LOG(Info) << "Dropped command (still running): " << command->text;
+        return false;
+    }
+
+    if (!queue_.push({command, event_time_us}))
+    {
+        command->in_flight.fetch_sub(1, std::memory_order_acq_rel);
+        LOG(Warn) << "Executor queue full, dropped: " << command->text;
+        return false;
+    }
+
+    uint64_t one = 1;
+    ssize_t ret = write(wake_fd_, &one, sizeof(one));
+    (void)ret;
+    return true;
+}
+
+bool Executor::submit_stream(const CommandRef &command, GestureKey key, int steps)
+{
+    if (!stream_queue_.push({command, key, steps}))
+        return false;
+
+    uint64_t one = 1;
+    ssize_t ret = write(wake_fd_, &one, sizeof(one));
+    (void)ret;
+    return true;
+}
+
+void Executor::run()
+{
+    while (!reactor_.stopping())
+    {
+        if (!reactor_.run_once())
+        {
+            LOG(Error) << "Executor epoll_wait failed: " << std::strerror(errno);
+            return;
+        }
+
+        uint64_t now = monotonic_ns();
+        for (const auto &sink : sinks_)
+            sink->flush(now);
+
+        start_pending();
+
+        // Sleep until the next sink is due; a delay of 0 would disarm
+        int64_t due = next_flush_ns(now);
+        reactor_.arm_timer(flush_timer_, due < 0 ? 0 : std::max<int64_t>(due, 1));
+    }
+}
+
+// Children always exit through a pidfd handler or here
+void Executor::watch_child(std::vector<Child> &children, Child &child)
+{
+    if (child.pidfd >= 0)
+    {
+        pid_t pid = child.pid;
+        std::vector<Child> *list = &children;
+        if (reactor_.add(child.pidfd, EPOLLIN, [this, list, pid](uint32_t) { reap_pid(*list, pid); }))
+            return;
+        // The reactor has logged it; sweep it like a child without a pidfd
+        close(child.pidfd);
+        child.pidfd = -1;
+    }
+    reactor_.arm_timer(sweep_timer_, FALLBACK_REAP_NS, FALLBACK_REAP_NS);
+}
+
+void Executor::reap_pid(std::vector<Child> &children, pid_t pid)
+{
+    for (size_t i = 0; i < children.size(); ++i)
+    {
+        if (children[i].pid == pid)
+        {
+            reap(children, i);
+            return;
+        }
+    }
+}
+
+// For children without a pidfd; the timer stops once none are left
+void Executor::sweep()
+{
+    bool waiting = false;
+    for (std::vector<Child> *children : {&children_, &sink_children_})
+    {
+        // Walk backwards so reap() can swap-remove
+        for (size_t i = children->size(); i-- > 0;)
+        {
+            if ((*children)[i].pidfd < 0 && !reap(*children, i))
+                waiting = true;
+        }
+    }
+    if (!waiting)
+        reactor_.arm_timer(sweep_timer_, 0);
+}
+
+void Executor::watch_sink(StreamSink &sink)
+{
+    StreamSink *target = &sink;
+    reactor_.add(sink.fd(), 0, [this, target](uint32_t events) {
+        if (!(events & (EPOLLHUP | EPOLLERR)))
+            return;
+        LOG(Warn) << "Stream to " << target->target() << " hung up";
+        reactor_.remove(target->fd());
+        target->hang_up();
+    });
+}
+
+void Executor::drain_queue()
+{
+    Job job;
+    while (queue_.pop(job))
+    {
+        if (coalesce(job) || !admit(job))
+        {
+            job.command->in_flight.fetch_sub(1, std::memory_order_acq_rel);
+            continue;
+        }
+
+        // Built-in actions finish immediately, so they don't need a slot
+        if (job.command->type() != ActionType::Process)
+        {
+            run_action(job);
+            job.command->in_flight.fetch_sub(1, std::memory_order_acq_rel);
+            continue;
+        }
+        pending_.push_back(std::move(job));
+    }
+}
+
+// Debounce, then rate limit; false if the job is to be dropped
+bool Executor::admit(const Job &job)
+{
+    Command &command = *job.command;
+    const CommandOptions &options = command.options;
+    if (options.debounce_ms <= 0 && options.limit_count <= 0)
+        return true;
+
+    uint64_t now = job.event_time_us ? job.event_time_us : monotonic_us();
+    if (options.debounce_ms > 0 && command.last_run_us &&
+        now < command.last_run_us + (uint64_t)options.debounce_ms * 1000)
+    {
+        LOG(Info) << "Debounced: " << command.text;
+        metric_counters.executor.throttled.add();
+        return false;
+    }
+
+    if (options.limit_count > 0)
+    {
+        // Starts full
+        double capacity = options.limit_count;
+        if (!command.tokens_us)
+        {
+            command.tokens = capacity;
+        }
+        else if (now > command.tokens_us)
+        {
+            double per_us = capacity / (std::max(options.limit_seconds, 0.001) * 1e6);
+            command.tokens = std::min(capacity, command.tokens + (double)(now - command.tokens_us) * per_us);
+        }
+        command.tokens_us = std::max(now, command.tokens_us);
+
+        if (command.tokens < 1.0)
+        {
+            LOG_LIMITED(Info, 1) << "Rate limited: " << command.text;
+            metric_counters.executor.throttled.add();
+            return false;
+        }
+        command.tokens -= 1.0;
+    }
+
+    command.last_run_us = now;
+    return true;
+}
+
+// Folds job into one of the same command still waiting, so that the latest
+// trigger is what runs; true if it did
+bool Executor::coalesce(const Job &job)
+{
+    if (!job.command->options.coalesce)
+        return false;
+    for (Job &waiting : pending_)
+    {
+        if (waiting.command == job.command)
+        {
+            waiting.event_time_us = job.event_time_us;
+            LOG(Debug) << "Coalesced: " << job.command->text;
+            metric_counters.executor.coalesced.add();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Executor::instance_running(const Command &command) const
+{
+    for (const Child &child : children_)
+    {
+        if (child.command.get() == &command)
+            return true;
+    }
+    return false;
+}
+
+bool Executor::run_action(const Job &job)
+{
+    const Command &command = *job.command;
+    if (!command.valid())
+    {
+        LOG(Error) << "Invalid action: " << command.text;
+        metric_counters.executor.action_failures.add();
+        return false;
+    }
+
+    const std::vector<std::string> &args = command.action_args();
+    bool ok = false;
+    switch (command.type())
+    {
+    case ActionType::Mpris:
+        ok = dbus_.mpris(args[0], args[1]);
+        break;
+    case ActionType::Notify:
+        ok = dbus_.notify(args[0]);
+        break;
+    case ActionType::DBus:
+        ok = dbus_.call(args[0], args[1], args[2], args[3],
+                        std::vector<std::string>(args.begin() + 4, args.end()));
+        break;
+    case ActionType::Keys:
+        ok = keyboard_.press(command.keys());
+        break;
+    case ActionType::Process:
+        break;
+    }
+
+    if (ok && job.event_time_us)
+        pipeline_stats.spawn.record(ns_since_us(job.event_time_us));
+    if (ok)
+        LOG(Info) << "Ran action: " << command.text;
+    (ok ? metric_counters.executor.actions : metric_counters.executor.action_failures).add();
+    return ok;
+}
+
+void Executor::drain_streams()
+{
+    uint64_t now = monotonic_ns();
+    StreamStep step;
+    while (stream_queue_.pop(step))
+    {
+        const std::string &target = step.command->text;
+
+        StreamSink *sink = nullptr;
+        for (const auto &candidate : sinks_)
+        {
+            if (candidate->target() == target)
+            {
+                sink = candidate.get();
+                break;
+            }
+        }
+        if (!sink)
+        {
+            sinks_.push_back(std::make_unique<StreamSink>(target));
+            sink = sinks_.back().get();
+        }
+
+        // Motion while the sink can't be reached is dropped, not replayed
+        if (!sink->connected() && !open_sink(*sink, now))
+            continue;
+
+        sink->add(step.key, step.steps, step.command->options.stream_rate, now);
+    }
+}
+
+bool Executor::open_sink(StreamSink &sink, uint64_t now_ns)
+{
+    if (!sink.retry_due(now_ns))
+        return false;
+    if (sink.is_socket())
+    {
+        if (!sink.connect_socket(now_ns))
+            return false;
+        watch_sink(sink);
+        return true;
+    }
+
+    // A socketpair rather than a pipe so writes can use MSG_NOSIGNAL
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) != 0)
+    {
+        LOG(Error) << "Failed to create stream socket: " << std::strerror(errno);
+        sink.open_failed(now_ns);
+        return false;
+    }
+
+    pid_t pid;
+    int err = spawn_shell(sink.target(), pair[1], pid);
+    close(pair[1]);
+    if (err != 0)
+    {
+        LOG(Error) << "Failed to run stream command: " << sink.target() << ": " << std::strerror(err);
+        metric_counters.executor.spawn_failures.add();
+        close(pair[0]);
+        sink.open_failed(now_ns);
+        return false;
+    }
+
+    LOG(Info) << "Streaming to command: " << sink.target();
+    metric_counters.executor.spawned.add();
+    sink.attach(pair[0]);
+    watch_sink(sink);
+    sink_children_.push_back({pid, open_pidfd(pid), nullptr, monotonic_ns()});
+    watch_child(sink_children_, sink_children_.back());
+    return true;
+}
+
+int64_t Executor::next_flush_ns(uint64_t now_ns) const
+{
+    int64_t next = -1;
+    for (const auto &sink : sinks_)
+    {
+        int64_t due = sink->due_in_ns(now_ns);
+        if (due >= 0 && (next < 0 || due < next))
+            next = due;
+    }
+    return next;
+}
+
+// In order, except that a coalescing binding's job waits for its running
+// instance to exit
+void Executor::start_pending()
+{
+    auto it = pending_.begin();
+    while (it != pending_.end() && (int)children_.size() < max_concurrent())
+    {
+        if (it->command->options.coalesce && instance_running(*it->command))
+        {
+            ++it;
+            continue;
+        }
+
+        Job job = std::move(*it);
+        it = pending_.erase(it);
+        if (!spawn(job))
+            job.command->in_flight.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
+
+bool Executor::spawn(const Job &job)
+{
+    const CommandRef &command = job.command;
+
+    // Plain command lines skip the shell's startup and parsing
+    pid_t pid;
+    int err = command->needs_shell() ? spawn_shell(command->text, -1, pid)
+                                     : spawn_process(command->program().c_str(), command->argv(), -1, pid);
+    if (err != 0)
+    {
+        LOG(Error) << "Failed to run command: " << command->text << ": " << std::strerror(err);
+        metric_counters.executor.spawn_failures.add();
+        return false;
+    }
+
+    if (job.event_time_us)
+        pipeline_stats.spawn.record(ns_since_us(job.event_time_us));
+    metric_counters.executor.spawned.add();
+
+    LOG(Info) << "Running command: " << command->text;
+
+    children_.push_back({pid, open_pidfd(pid), command, monotonic_ns()});
+    watch_child(children_, children_.back());
+    running_.store((int)children_.size(), std::memory_order_relaxed);
+    return true;
+}
+
+// -1 if pidfds are unavailable; such children are swept with waitpid instead
+int Executor::open_pidfd(pid_t pid)
+{
+    if (!have_pidfd_)
+        return -1;
+    int pidfd = pidfd_open(pid);
+    if (pidfd < 0 && errno == ENOSYS)
+        have_pidfd_ = false;
+    return pidfd;
+}
+
+bool Executor::reap(std::vector<Child> &children, size_t index)
+{
+    Child &child = children[index];
+    if (waitpid(child.pid, nullptr, WNOHANG) == 0)
+        return false;
+
+    if (child.pidfd >= 0)
+    {
+        reactor_.remove(child.pidfd);
+        close(child.pidfd);
+    }
+    if (child.command)
+    {
+        child.command->in_flight.fetch_sub(1, std::memory_order_acq_rel);
+        metric_counters.executor.command_duration.record(monotonic_ns() - child.start_ns);
+    }
+    children[index] = std::move(children.back());
+    children.pop_back();
+    running_.store((int)children_.size(), std::memory_order_relaxed);
+    return true;
+}
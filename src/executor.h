@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+
+#include "command.h"
+#include "dbus_actions.h"
+#include "gesture.h"
+#include "reactor.h"
+#include "ring_buffer.h"
+#include "stream_sink.h"
+#include "uinput_keyboard.h"
+
+// Runs bound commands off the input thread.
+//
+// submit() only pushes onto a lock-free queue and kicks an eventfd; the
+// executor thread spawns the command via posix_spawn (directly when it's a
+// plain command line, otherwise through /bin/sh -c) and reaps children
+// through pidfd handlers on its Reactor, so neither gesture handling nor
+// the GUI waits for a command to exit. Built-in actions (D-Bus calls, uinput keys) run right on
+// the executor thread over connections it keeps open.
+//
+// Bindings can be throttled (see CommandOptions): debounce windows and token
+// bucket rate limits are checked as jobs come off the queue, and a
+// coalescing binding keeps at most one job waiting behind its running
+// instance, the latest one. All of it runs on the executor thread, against
+// the triggering events' timestamps, so a burst of gestures costs the input
+// thread no more than before and at most one extra spawn.
+//
+// Streaming bindings go through a second queue to StreamSinks the executor
+// thread opens on first use and keeps open, so a continuous gesture costs
+// one write per rate interval rather than a process per step.
+class Executor {
+public:
+    explicit Executor(int max_concurrent = 8);
+    ~Executor();
+
+    bool start();
+    void stop();
+
+    // Input thread side. Returns false if the command was dropped, either
+    // because of its drop-if-running policy or because the queue is full.
+    // event_time_us is the triggering event's libinput timestamp, used for
+    // spawn latency stats (0 if unknown).
+    bool submit(const CommandRef &command, uint64_t event_time_us = 0);
+
+    // Input thread side. Queues steps of motion for a streaming binding;
+    // returns false if the queue is full.
+    bool submit_stream(const CommandRef &command, GestureKey key, int steps);
+
+    // Upper bound on children alive at once; extra jobs wait for a slot.
+    void set_max_concurrent(int n) { max_concurrent_.store(n < 1 ? 1 : n, std::memory_order_relaxed); }
+    int max_concurrent() const { return max_concurrent_.load(std::memory_order_relaxed); }
+
+    int running() const { return running_.load(std::memory_order_relaxed); }
+
+private:
+    struct Job {
+        CommandRef command;
+        uint64_t event_time_us = 0;
+    };
+
+    struct StreamStep {
+        CommandRef command;
+        GestureKey key = 0;
+        int steps = 0;
+    };
+
+    struct Child {
+        pid_t pid;
+        int pidfd;
+        CommandRef command;     // null for stream sink processes
+        uint64_t start_ns;      // when it was spawned
+    };
+
+    void run();
+    void drain_queue();
+    void drain_streams();
+    bool admit(const Job &job);
+    bool coalesce(const Job &job);
+    bool instance_running(const Command &command) const;
+    void start_pending();
+    bool spawn(const Job &job);
+    bool run_action(const Job &job);
+    bool open_sink(StreamSink &sink, uint64_t now_ns);
+    int64_t next_flush_ns(uint64_t now_ns) const;
+    int open_pidfd(pid_t pid);
+    void watch_child(std::vector<Child> &children, Child &child);
+    void watch_sink(StreamSink &sink);
+    void reap_pid(std::vector<Child> &children, pid_t pid);
+    void sweep();
+    bool reap(std::vector<Child> &children, size_t index);
+
+    BoundedQueue<Job, 64> queue_;
+    std::deque<Job> pending_;
+    std::vector<Child> children_;
+
+    BoundedQueue<StreamStep, 256> stream_queue_;
+    std::vector<std::unique_ptr<StreamSink>> sinks_;
+    std::vector<Child> sink_children_;
+
+    DbusActions dbus_;
+    UinputKeyboard keyboard_;
+
+    std::atomic<int> max_concurrent_;
+    std::atomic<int> running_{0};
+
+    std::thread thread_;
+    Reactor reactor_;
+    int wake_fd_ = -1;
+    int flush_timer_ = -1;      // next sink due
+    int sweep_timer_ = -1;      // children without a pidfd
+    bool have_pidfd_ = true;
+};
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Recognised gestures are packed into a small integer so bindings can live in
+// a flat array indexed by it:
+//
+//     bits 0-1  variant: direction, pinch direction or hold length
+//     bits 2-4  finger count (0-7)
+//     bits 5-7  kind
+using GestureKey = uint16_t;
+
+// Two-finger scrolling is treated as a swipe of its own kind
+enum class GestureKind : uint8_t {
+    Swipe = 0,
+    Pinch,
+    Hold,
+    Scroll,
+};
+
+enum class Direction : uint8_t {
+    Left = 0,
+    Right,
+    Up,
+    Down,
+};
+
+enum class PinchDirection : uint8_t {
+    In = 0,
+    Out,
+};
+
+enum class HoldLength : uint8_t {
+    Short = 0,
+    Long,
+};
+
+constexpr int GESTURE_DIRECTION_COUNT = 4;
+constexpr int GESTURE_VARIANT_COUNT = 4;
+constexpr int GESTURE_MAX_FINGERS = 7;
+constexpr int GESTURE_KIND_COUNT = 8;
+constexpr int GESTURE_KINDS_DEFINED = 4;
+constexpr size_t GESTURE_KEY_COUNT = GESTURE_KIND_COUNT * (GESTURE_MAX_FINGERS + 1) * GESTURE_VARIANT_COUNT;
+
+constexpr GestureKey make_gesture_key(GestureKind kind, int fingers, int variant)
+{
+    return (GestureKey)(((unsigned)kind << 5) | ((unsigned)fingers << 2) | (unsigned)variant);
+}
+
+constexpr GestureKey make_gesture_key(GestureKind kind, int fingers, Direction dir)
+{
+    return make_gesture_key(kind, fingers, (int)dir);
+}
+
+constexpr GestureKey make_gesture_key(int fingers, PinchDirection dir)
+{
+    return make_gesture_key(GestureKind::Pinch, fingers, (int)dir);
+}
+
+constexpr GestureKey make_gesture_key(int fingers, HoldLength length)
+{
+    return make_gesture_key(GestureKind::Hold, fingers, (int)length);
+}
+
+constexpr bool gesture_fingers_valid(int fingers)
+{
+    return fingers >= 1 && fingers <= GESTURE_MAX_FINGERS;
+}
+
+constexpr GestureKind gesture_kind(GestureKey key) { return (GestureKind)(key >> 5); }
+constexpr int gesture_fingers(GestureKey key) { return (key >> 2) & 0x7; }
+constexpr int gesture_variant(GestureKey key) { return key & 0x3; }
+constexpr Direction gesture_direction(GestureKey key) { return (Direction)(key & 0x3); }
+
+constexpr const char *GESTURE_KIND_NAMES[GESTURE_KINDS_DEFINED] = {"swipe", "pinch", "hold", "scroll"};
+
+constexpr const char *gesture_kind_name(GestureKind kind)
+{
+    return (unsigned)kind < GESTURE_KINDS_DEFINED ? GESTURE_KIND_NAMES[(unsigned)kind] : "unknown";
+}
+
+// Unused variants are null
+constexpr const char *GESTURE_VARIANT_NAMES[GESTURE_KINDS_DEFINED][GESTURE_VARIANT_COUNT] = {
+    {"LEFT", "RIGHT", "UP", "DOWN"},
+    {"IN", "OUT", nullptr, nullptr},
+    {"SHORT", "LONG", nullptr, nullptr},
+    {"LEFT", "RIGHT", "UP", "DOWN"},
+};
+
+constexpr bool gesture_variant_valid(GestureKind kind, int variant)
+{
+    return (unsigned)kind < GESTURE_KINDS_DEFINED && variant >= 0 && variant < GESTURE_VARIANT_COUNT &&
+           GESTURE_VARIANT_NAMES[(unsigned)kind][variant] != nullptr;
+}
+
+constexpr const char *gesture_variant_name(GestureKey key)
+{
+    return gesture_variant_valid(gesture_kind(key), gesture_variant(key))
+               ? GESTURE_VARIANT_NAMES[(unsigned)gesture_kind(key)][gesture_variant(key)]
+               : "?";
+}
+
+inline bool parse_gesture_kind(const char *name, GestureKind &kind)
+{
+    for (int i = 0; i < GESTURE_KINDS_DEFINED; ++i)
+    {
+        if (std::strcmp(name, GESTURE_KIND_NAMES[i]) == 0)
+        {
+            kind = (GestureKind)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool parse_gesture_variant(GestureKind kind, const char *name, int &variant)
+{
+    for (int i = 0; i < GESTURE_VARIANT_COUNT; ++i)
+    {
+        if (gesture_variant_valid(kind, i) && std::strcmp(name, GESTURE_VARIANT_NAMES[(unsigned)kind][i]) == 0)
+        {
+            variant = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Distances are millimetres of finger travel on the touchpad. libinput
+// reports motion as if from a 1000 dpi device.
+constexpr double LIBINPUT_UNIT_MM = 25.4 / 1000.0;
+
+// Motion a swipe needs along its dominant axis to count, on a touchpad
+// whose size isn't known and that has no threshold of its own
+constexpr double SWIPE_THRESHOLD_MM = 5.0;
+
+// A touchpad of known size gets this share of its shorter side instead,
+// within the limits, so a swipe is about as much of a stroke on any pad
+constexpr double SWIPE_THRESHOLD_SHARE = 0.08;
+constexpr double SWIPE_THRESHOLD_MIN_MM = 3.0;
+constexpr double SWIPE_THRESHOLD_MAX_MM = 12.0;
+
+// Total pinch scale beyond which a pinch counts as in or out
+constexpr double PINCH_IN_SCALE = 0.9;
+constexpr double PINCH_OUT_SCALE = 1.1;
+
+// What one touchpad needs to recognise gestures with a given finger count
+struct GestureThresholds {
+    float swipe_mm = (float)SWIPE_THRESHOLD_MM;
+    float pinch_in = (float)PINCH_IN_SCALE;
+    float pinch_out = (float)PINCH_OUT_SCALE;
+
+    bool operator==(const GestureThresholds &other) const
+    {
+        return swipe_mm == other.swipe_mm && pinch_in == other.pinch_in && pinch_out == other.pinch_out;
+    }
+    bool operator!=(const GestureThresholds &other) const { return !(*this == other); }
+};
+
+// Indexed by finger count
+using FingerThresholds = std::array<GestureThresholds, GESTURE_MAX_FINGERS + 1>;
+
+// False for values no recogniser could work with
+inline bool gesture_thresholds_sane(const GestureThresholds &t)
+{
+    return t.swipe_mm > 0.0f && t.pinch_in > 0.0f && t.pinch_in < 1.0f && t.pinch_out > 1.0f;
+}
+
+// Thresholds for a touchpad with no settings of its own; width and height
+// are 0 when libinput doesn't know the size
+inline FingerThresholds default_thresholds(double width_mm, double height_mm)
+{
+    FingerThresholds thresholds;
+    if (width_mm > 0.0 && height_mm > 0.0)
+    {
+        double swipe = SWIPE_THRESHOLD_SHARE * std::min(width_mm, height_mm);
+        swipe = std::max(SWIPE_THRESHOLD_MIN_MM, std::min(swipe, SWIPE_THRESHOLD_MAX_MM));
+        for (GestureThresholds &t : thresholds)
+            t.swipe_mm = (float)swipe;
+    }
+    return thresholds;
+}
+
+// How long a hold must last, from HOLD_BEGIN to HOLD_END, to count as short
+// or long
+constexpr uint64_t HOLD_SHORT_US = 300000;
+constexpr uint64_t HOLD_LONG_US = 1000000;
+
+// Swipe direction from the accumulated motion, or false if neither axis
+// travelled past threshold
+inline bool classify_swipe(double dx, double dy, double threshold, Direction &dir)
+{
+    if (std::abs(dx) > std::abs(dy)) {
+        if (dx > threshold)
+            dir = Direction::Right;
+        else if (dx < -threshold)
+            dir = Direction::Left;
+        else
+            return false;
+    } else {
+        if (dy > threshold)
+            dir = Direction::Down;
+        else if (dy < -threshold)
+            dir = Direction::Up;
+        else
+            return false;
+    }
+    return true;
+}
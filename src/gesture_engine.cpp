@@ -0,0 +1,176 @@
+#include "gesture_engine.h"
+
+#include <algorithm>
+
+static size_t emit(GestureEngine::Output &out, size_t n, RecognizedType type, GestureKey key,
+                   uint64_t time_us, int steps = 0)
+{
+    out[n] = {type, key, steps, time_us};
+    return n + 1;
+}
+
+// A zero axis value ends a scroll sequence, so it never merges
+static bool scroll_stopped(const TraceEvent &event)
+{
+    return ((event.flags & TRACE_SCROLL_V) && event.dy == 0.0f) ||
+           ((event.flags & TRACE_SCROLL_H) && event.dx == 0.0f);
+}
+
+bool coalesce_update(TraceEvent &pending, const TraceEvent &next)
+{
+    if (next.type != pending.type || next.device != pending.device ||
+        next.fingers != pending.fingers || next.flags != pending.flags)
+        return false;
+
+    switch (next.type)
+    {
+        case TraceEventType::SwipeUpdate:
+            break;
+        case TraceEventType::PinchUpdate:
+            pending.scale = next.scale;
+            break;
+        case TraceEventType::Scroll:
+            if (scroll_stopped(pending) || scroll_stopped(next))
+                return false;
+            break;
+        default:
+            return false;
+    }
+
+    pending.dx += next.dx;
+    pending.dy += next.dy;
+    pending.time_us = next.time_us;
+    return true;
+}
+
+// Shared by swipes and scrolls
+size_t GestureEngine::update_swipe(SwipeRecognizer &swipe, double dx, double dy, uint64_t time_us,
+                                   const BindingTable &bindings, Output &out, size_t n)
+{
+    GestureKey key;
+    bool was_streaming = swipe.streaming();
+    if (swipe.update(dx, dy, bindings, key))
+        return emit(out, n, RecognizedType::Fire, key, time_us);
+
+    if (swipe.streaming())
+    {
+        if (!was_streaming)
+            n = emit(out, n, RecognizedType::StreamStart, swipe.stream_key(), time_us);
+        int steps = swipe.take_stream_steps();
+        if (steps != 0)
+            n = emit(out, n, RecognizedType::Stream, swipe.stream_key(), time_us, steps);
+    }
+    return n;
+}
+
+size_t GestureEngine::end_swipe(SwipeRecognizer &swipe, bool cancelled, uint64_t time_us,
+                                const BindingTable &bindings, Output &out, size_t n)
+{
+    GestureKey key;
+    if (swipe.end(cancelled, bindings, key))
+        return emit(out, n, RecognizedType::Fire, key, time_us);
+    if (swipe.cancelled())
+        return emit(out, n, RecognizedType::Reversed, key, time_us);
+    if (swipe.fell_short())
+        return emit(out, n, RecognizedType::Short, key, time_us);
+    return n;
+}
+
+static const GestureThresholds &for_fingers(const FingerThresholds &thresholds, int fingers)
+{
+    return thresholds[std::min(std::max(fingers, 0), GESTURE_MAX_FINGERS)];
+}
+
+// Finger scrolling has no begin/end events of its own: a sequence starts at
+// the first non-zero axis value and ends with a zero one
+size_t GestureEngine::feed_scroll(SwipeRecognizer &scroll, const TraceEvent &event, const BindingTable &bindings,
+                                  Output &out)
+{
+    if (!(event.flags & TRACE_SCROLL_FINGER))
+        return 0;
+
+    bool stopped = scroll_stopped(event);
+
+    if (!scroll.active())
+    {
+        if (stopped)
+            return 0;
+        scroll.begin(2, GestureKind::Scroll, for_fingers(thresholds_[event.device], 2).swipe_mm);
+    }
+
+    size_t n = update_swipe(scroll, event.dx, event.dy, event.time_us, bindings, out, 0);
+    if (stopped)
+        n = end_swipe(scroll, false, event.time_us, bindings, out, n);
+    return n;
+}
+
+size_t GestureEngine::feed(const TraceEvent &event, const BindingTable &bindings, Output &out)
+{
+    Device &device = devices_[event.device];
+    GestureKey key;
+
+    switch (event.type)
+    {
+        case TraceEventType::DeviceAdded:
+        case TraceEventType::DeviceRemoved:
+            device = Device();
+            return 0;
+
+        case TraceEventType::SwipeBegin:
+            device.swipe.begin(event.fingers, GestureKind::Swipe,
+                               for_fingers(thresholds_[event.device], event.fingers).swipe_mm);
+            return 0;
+
+        case TraceEventType::SwipeUpdate:
+            return update_swipe(device.swipe, event.dx, event.dy, event.time_us, bindings, out, 0);
+
+        case TraceEventType::SwipeEnd:
+            return end_swipe(device.swipe, event.flags & TRACE_CANCELLED, event.time_us, bindings, out, 0);
+
+        case TraceEventType::Scroll:
+            return feed_scroll(device.scroll, event, bindings, out);
+
+        case TraceEventType::PinchBegin:
+        {
+            const GestureThresholds &thresholds = for_fingers(thresholds_[event.device], event.fingers);
+            device.pinch.begin(event.fingers, thresholds.pinch_in, thresholds.pinch_out);
+            return 0;
+        }
+
+        case TraceEventType::PinchUpdate:
+        {
+            PinchRecognizer &pinch = device.pinch;
+            bool was_streaming = pinch.streaming();
+            pinch.update(event.scale, event.dx, event.dy, bindings);
+
+            size_t n = 0;
+            if (pinch.streaming())
+            {
+                if (!was_streaming)
+                    n = emit(out, n, RecognizedType::StreamStart, pinch.stream_key(), event.time_us);
+                int steps = pinch.take_stream_steps();
+                if (steps != 0)
+                    n = emit(out, n, RecognizedType::Stream, pinch.stream_key(), event.time_us, steps);
+            }
+            return n;
+        }
+
+        case TraceEventType::PinchEnd:
+            if (device.pinch.end(event.flags & TRACE_CANCELLED, key))
+                return emit(out, 0, RecognizedType::Fire, key, event.time_us);
+            if (device.pinch.fell_short())
+                return emit(out, 0, RecognizedType::Short, key, event.time_us);
+            return 0;
+
+        case TraceEventType::HoldBegin:
+            device.hold.begin(event.fingers, event.time_us);
+            return 0;
+
+        case TraceEventType::HoldEnd:
+            if (device.hold.end(event.time_us, event.flags & TRACE_CANCELLED, bindings, key))
+                return emit(out, 0, device.hold.moved() ? RecognizedType::Moved : RecognizedType::Fire, key,
+                            event.time_us);
+            return 0;
+    }
+    return 0;
+}
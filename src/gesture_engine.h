@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "bindings.h"
+#include "gesture.h"
+#include "hold_recognizer.h"
+#include "pinch_recognizer.h"
+#include "swipe_recognizer.h"
+#include "trace.h"
+
+// What feeding an event recognised
+enum class RecognizedType : uint8_t {
+    Fire,           // run the command bound to key (which may be unbound)
+    StreamStart,    // a streaming binding took the gesture over
+    Stream,         // steps of motion for a streaming binding
+    Reversed,       // a swipe was pulled back and discarded
+    Moved,          // a hold the fingers moved on from: counts towards
+                    // sequences but runs nothing itself
+    Short,          // a swipe, scroll or pinch that ended short of its
+                    // threshold; key is the way it was heading
+};
+
+struct RecognizedGesture {
+    RecognizedType type;
+    GestureKey key;
+    int steps;          // Stream only
+    uint64_t time_us;   // of the event that recognised it
+};
+
+// Folds next into pending when both are motion updates of the same gesture
+// on the same device: swipe and scroll deltas are summed, and a pinch keeps
+// the latest scale since libinput reports it relative to PINCH_BEGIN. The
+// merged event carries next's timestamp. Feeding the result instead of both
+// recognises the same gestures, except that a swipe reversed within the
+// merged updates has its furthest point taken from the sum.
+bool coalesce_update(TraceEvent &pending, const TraceEvent &next);
+
+// Most gestures a single event can produce, e.g. a scroll that fires early
+// and stops in the same event
+constexpr size_t GESTURE_ENGINE_MAX_OUTPUT = 4;
+
+// The gesture state machines for every device, with no I/O of their own:
+// feed it events, in order, and act on what comes out. Each device id has a
+// fixed slot, so feeding never allocates.
+class GestureEngine {
+public:
+    // The recognisers kept for one device
+    struct Device {
+        SwipeRecognizer swipe;
+        SwipeRecognizer scroll;
+        PinchRecognizer pinch;
+        HoldRecognizer hold;
+    };
+
+    using Output = RecognizedGesture[GESTURE_ENGINE_MAX_OUTPUT];
+
+    // Feeds one event from device event.device; returns how many entries of
+    // out were filled. bindings decide early, streaming and hold lengths.
+    size_t feed(const TraceEvent &event, const BindingTable &bindings, Output &out);
+
+    const Device &device(uint8_t id) const { return devices_[id]; }
+
+    // Used for gestures starting on device id from now on; devices start
+    // out with default_thresholds() for an unknown size
+    void set_thresholds(uint8_t id, const FingerThresholds &thresholds) { thresholds_[id] = thresholds; }
+    const FingerThresholds &thresholds(uint8_t id) const { return thresholds_[id]; }
+
+private:
+    size_t feed_scroll(SwipeRecognizer &scroll, const TraceEvent &event, const BindingTable &bindings, Output &out);
+    size_t update_swipe(SwipeRecognizer &swipe, double dx, double dy, uint64_t time_us,
+                        const BindingTable &bindings, Output &out, size_t n);
+    size_t end_swipe(SwipeRecognizer &swipe, bool cancelled, uint64_t time_us, const BindingTable &bindings,
+                     Output &out, size_t n);
+
+    std::array<Device, 256> devices_;
+    // Kept apart so that DeviceAdded, which resets the device, keeps them
+    std::array<FingerThresholds, 256> thresholds_;
+};
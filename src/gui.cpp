@@ -0,0 +1,429 @@
+#include "gui.h"
+
+#include "binding_editor.h"
+#include "binding_store.h"
+#include "clock.h"
+#include "log.h"
+#include "stats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+// GLFW and ImGui includes
+#include <GLFW/glfw3.h>
+#include "imgui.h"
+#include "imgui_impl_glfw.h"
+#include "imgui_impl_opengl3.h"
+
+static Snapshot<BindingTable> *binding_snapshot;
+static std::string store_path;
+
+// Frames to keep drawing after a wakeup so ImGui can settle hover/active state
+static const int SETTLE_FRAMES = 3;
+
+// Longest the window sleeps with nothing happening; only refreshes counters
+static const double IDLE_TIMEOUT_SECONDS = 1.0;
+
+// How long "Gesture detected" stays highlighted
+static const double FLASH_SECONDS = 0.6;
+
+// Edits are saved once they have paused this long, so dragging a value
+// doesn't fsync the store every frame
+static const double SAVE_DELAY_SECONDS = 1.0;
+
+// Finger counts the bindings window has gestures for
+static const int THRESHOLD_MIN_FINGERS = 2;
+static const int THRESHOLD_MAX_FINGERS = 4;
+
+// Runs on the input thread; glfwPostEmptyEvent is thread-safe
+static void wake_gui()
+{
+    glfwPostEmptyEvent();
+}
+
+// Hand the input thread a fresh copy after every edit
+static void publish_bindings(const BindingEditor &editor)
+{
+    binding_snapshot->publish(std::make_unique<BindingTable>(editor.table()));
+}
+
+int run_gui(BindingConfig &config, const std::string &path, Snapshot<BindingTable> &snapshot,
+            InputThread &input, Executor &executor, Reactor &events)
+{
+    store_path = path;
+    binding_snapshot = &snapshot;
+
+    // Initialize GLFW
+    if (!glfwInit())
+    {
+        LOG(Error) << "Failed to initialize GLFW";
+        return 1;
+    }
+
+    // Setup OpenGL version (3.3 core)
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    GLFWwindow *window = glfwCreateWindow(800, 600, "Touchpad Gesture Daemon", NULL, NULL);
+    if (!window)
+    {
+        LOG(Error) << "Failed to create GLFW window";
+        glfwTerminate();
+        return 1;
+    }
+
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(1); // Enable vsync
+
+    // Setup ImGui context
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO &io = ImGui::GetIO();
+    (void)io;
+
+    // Setup ImGui style
+    ImGui::StyleColorsDark();
+
+    // Setup Platform/Renderer backends
+    ImGui_ImplGlfw_InitForOpenGL(window, true);
+    ImGui_ImplOpenGL3_Init("#version 330");
+
+    BindingEditor editor(config);
+
+    input.set_status_listener(wake_gui);
+    uint64_t seen_gestures = input.status().gestures;
+    double flash_until = 0.0;
+    int settle_frames = SETTLE_FRAMES;
+
+    // Refetched only when a touchpad comes or goes
+    std::vector<TouchpadInfo> touchpads;
+    uint64_t seen_touchpads = UINT64_MAX;
+
+    // 0 while nothing is waiting to be saved
+    double save_at = 0.0;
+
+    // Signals, control requests and the input thread giving up are handled
+    // beside the window rather than between frames; once the loop stops (or
+    // fails) the window is woken to close
+    std::atomic<bool> closing{false};
+    std::atomic<bool> events_done{false};
+    std::thread events_thread([&] {
+        while (!closing.load(std::memory_order_acquire) && !events.stopping()) {
+            if (!events.run_once())
+                break;
+        }
+        events_done.store(true, std::memory_order_release);
+        glfwPostEmptyEvent();
+    });
+
+    while (!glfwWindowShouldClose(window) && !events_done.load(std::memory_order_acquire))
+    {
+        // Sleep until GLFW input, a gesture from the input thread, the end
+        // of the current highlight or a save falling due; then draw a few
+        // frames and sleep again
+        if (settle_frames > 0) {
+            glfwPollEvents();
+            settle_frames--;
+        } else {
+            double now = glfwGetTime();
+            double timeout = flash_until > now ? flash_until - now : IDLE_TIMEOUT_SECONDS;
+            if (save_at > 0.0)
+                timeout = std::min(timeout, std::max(save_at - now, 0.0));
+            glfwWaitEventsTimeout(timeout);
+            settle_frames = SETTLE_FRAMES;
+        }
+
+        uint64_t frame_start = monotonic_ns();
+
+        // Start ImGui frame
+        ImGui_ImplOpenGL3_NewFrame();
+        ImGui_ImplGlfw_NewFrame();
+        ImGui::NewFrame();
+        ImGui::SetNextWindowPos(ImVec2(100, 100), ImGuiCond_FirstUseEver);
+        ImGui::SetNextWindowSize(ImVec2(600, 350), ImGuiCond_FirstUseEver);
+        
+        ImGui::Begin("Gesture Bindings");
+
+        static char custom_cmd[256] = "";
+        ImGui::InputText("Custom Command", custom_cmd, IM_ARRAYSIZE(custom_cmd));
+        ImGui::SameLine();
+        if (ImGui::Button("Add")) {
+            editor.add_command(custom_cmd);
+            custom_cmd[0] = '\0'; // clear input
+        }
+        ImGui::Separator();
+
+        // Display
+        const std::vector<std::string>& all_commands = editor.commands();
+        const std::vector<BindingEditor::Row>& rows = editor.rows();
+
+        for (size_t r = 0; r < rows.size(); ++r) {
+            const BindingEditor::Row& row = rows[r];
+            int selected = row.selected;
+            GestureKind kind = gesture_kind(row.key);
+            if (r == 0 || kind != gesture_kind(rows[r - 1].key))
+                ImGui::TextDisabled("%s", gesture_kind_name(kind));
+
+            if (ImGui::BeginCombo(row.label.c_str(), all_commands[selected].c_str())) {
+                for (int i = 0; i < (int)all_commands.size(); ++i) {
+                    bool is_selected = (selected == i);
+                    if (ImGui::Selectable(all_commands[i].c_str(), is_selected)) {
+                        editor.bind(r, i);
+
+                        if (i == 0) {
+                            LOG(Info) << "Unbound " << row.label;
+                        } else {
+                            LOG(Info) << "Bound " << row.label
+                                    << " -> " << all_commands[i];
+                        }
+                    }
+                    if (is_selected)
+                        ImGui::SetItemDefaultFocus();
+                }
+                ImGui::EndCombo();
+            }
+
+            const CommandRef& bound = editor.binding(r);
+            if (bound) {
+                ImGui::SameLine();
+                ImGui::PushID(row.label.c_str());
+                CommandOptions options = bound->options;
+                bool edited = false;
+                if (kind != GestureKind::Hold) {
+                    edited |= ImGui::Checkbox("Stream", &options.stream);
+                    ImGui::SameLine();
+                }
+                if (options.stream && kind != GestureKind::Hold) {
+                    ImGui::SetNextItemWidth(80);
+                    double default_step = kind == GestureKind::Pinch ? STREAM_STEP_PERCENT : STREAM_STEP_MM;
+                    float step = (float)(options.stream_step > 0.0 ? options.stream_step : default_step);
+                    ImGui::InputFloat(kind == GestureKind::Pinch ? "Step (%)" : "Step (mm)", &step, 0, 0, "%.1f");
+                    if (ImGui::IsItemDeactivatedAfterEdit()) {
+                        options.stream_step = step > 0.0f ? step : 0.0;
+                        edited = true;
+                    }
+                    ImGui::SameLine();
+                    ImGui::SetNextItemWidth(80);
+                    int rate = options.stream_rate;
+                    ImGui::InputInt("Rate (Hz)", &rate, 0);
+                    if (ImGui::IsItemDeactivatedAfterEdit()) {
+                        options.stream_rate = rate > 0 ? rate : 0;
+                        edited = true;
+                    }
+                } else {
+                    edited |= ImGui::Checkbox("Drop if running", &options.drop_if_running);
+                    ImGui::SameLine();
+                    edited |= ImGui::Checkbox("Coalesce", &options.coalesce);
+                    ImGui::SameLine();
+                    ImGui::SetNextItemWidth(60);
+                    int debounce = options.debounce_ms;
+                    ImGui::InputInt("Debounce (ms)", &debounce, 0);
+                    if (ImGui::IsItemDeactivatedAfterEdit()) {
+                        options.debounce_ms = debounce > 0 ? debounce : 0;
+                        edited = true;
+                    }
+                    ImGui::SameLine();
+                    ImGui::SetNextItemWidth(40);
+                    int limit = options.limit_count;
+                    ImGui::InputInt("Limit", &limit, 0);
+                    if (ImGui::IsItemDeactivatedAfterEdit()) {
+                        options.limit_count = limit > 0 ? limit : 0;
+                        edited = true;
+                    }
+                    if (options.limit_count > 0) {
+                        ImGui::SameLine();
+                        ImGui::SetNextItemWidth(50);
+                        float seconds = (float)options.limit_seconds;
+                        ImGui::InputFloat("per (s)", &seconds, 0, 0, "%.1f");
+                        if (ImGui::IsItemDeactivatedAfterEdit() && seconds > 0.0f) {
+                            options.limit_seconds = seconds;
+                            edited = true;
+                        }
+                    }
+                    if (kind == GestureKind::Swipe || kind == GestureKind::Scroll) {
+                        ImGui::SameLine();
+                        edited |= ImGui::Checkbox("Cancel if reversed", &options.cancel_if_reversed);
+                        ImGui::SameLine();
+                        ImGui::SetNextItemWidth(80);
+                        float early = (float)options.early_distance;
+                        ImGui::InputFloat("Early (mm)", &early, 0, 0, "%.1f");
+                        if (ImGui::IsItemDeactivatedAfterEdit()) {
+                            options.early_distance = early > 0.0f ? early : 0.0;
+                            edited = true;
+                        }
+                    }
+                }
+                if (edited)
+                    editor.set_options(r, options);
+                ImGui::PopID();
+            }
+        }
+
+        if (ImGui::CollapsingHeader("Touchpads")) {
+            uint64_t generation = input.touchpad_generation();
+            if (generation != seen_touchpads) {
+                touchpads = input.touchpads();
+                seen_touchpads = generation;
+            }
+            if (touchpads.empty())
+                ImGui::TextDisabled("No touchpad connected");
+
+            for (const TouchpadInfo& touchpad : touchpads) {
+                ImGui::PushID(touchpad.name.c_str());
+                if (touchpad.width_mm > 0.0)
+                    ImGui::Text("%s (%.0f x %.0f mm)", touchpad.name.c_str(), touchpad.width_mm, touchpad.height_mm);
+                else
+                    ImGui::Text("%s", touchpad.name.c_str());
+
+                const FingerThresholds* own = editor.device_thresholds(touchpad.name);
+                FingerThresholds thresholds = own ? *own : default_thresholds(touchpad.width_mm, touchpad.height_mm);
+                bool edited = false;
+                bool sane = true;
+                for (int fingers = THRESHOLD_MIN_FINGERS; fingers <= THRESHOLD_MAX_FINGERS; ++fingers) {
+                    GestureThresholds& t = thresholds[fingers];
+                    ImGui::PushID(fingers);
+                    ImGui::Text("%dF", fingers);
+                    ImGui::SameLine();
+                    ImGui::SetNextItemWidth(80);
+                    ImGui::InputFloat("Swipe (mm)", &t.swipe_mm, 0, 0, "%.1f");
+                    edited |= ImGui::IsItemDeactivatedAfterEdit();
+                    ImGui::SameLine();
+                    ImGui::SetNextItemWidth(80);
+                    ImGui::InputFloat("Pinch in", &t.pinch_in, 0, 0, "%.2f");
+                    edited |= ImGui::IsItemDeactivatedAfterEdit();
+                    ImGui::SameLine();
+                    ImGui::SetNextItemWidth(80);
+                    ImGui::InputFloat("Pinch out", &t.pinch_out, 0, 0, "%.2f");
+                    edited |= ImGui::IsItemDeactivatedAfterEdit();
+                    ImGui::PopID();
+                    sane &= gesture_thresholds_sane(t);
+                }
+                // Values that would never recognise anything are dropped
+                if (edited && sane)
+                    editor.set_device_thresholds(touchpad.name, thresholds);
+                if (own && ImGui::Button("Use defaults"))
+                    editor.reset_device_thresholds(touchpad.name);
+                ImGui::PopID();
+            }
+        }
+
+        if (editor.take_changed()) {
+            publish_bindings(editor);
+            save_at = glfwGetTime() + SAVE_DELAY_SECONDS;
+        }
+        if (save_at > 0.0 && glfwGetTime() >= save_at && !ImGui::IsAnyItemActive()) {
+            save_binding_store(store_path, editor.config());
+            save_at = 0.0;
+        }
+
+        ImGui::Separator();
+        int max_jobs = executor.max_concurrent();
+        if (ImGui::InputInt("Max concurrent commands", &max_jobs))
+            executor.set_max_concurrent(max_jobs);
+        int level = (int)log_level();
+        if (ImGui::Combo("Log level", &level, "error\0warn\0info\0debug\0trace\0"))
+            set_log_level((LogLevel)level);
+
+        ImGui::Separator();
+        GestureStatus status = input.status();
+        if (status.gestures != seen_gestures) {
+            seen_gestures = status.gestures;
+            flash_until = glfwGetTime() + FLASH_SECONDS;
+        }
+        if (glfwGetTime() < flash_until)
+            ImGui::TextColored(ImVec4(0.4f, 1.0f, 0.4f, 1.0f), "Gesture detected");
+        else
+            ImGui::TextDisabled("Gesture detected");
+        if (status.gestures > 0)
+            ImGui::Text("Last gesture: %dF %s %s (%s)", gesture_fingers(status.last_gesture),
+                        gesture_kind_name(gesture_kind(status.last_gesture)),
+                        gesture_variant_name(status.last_gesture),
+                        status.last_bound ? "bound" : "unbound");
+        else
+            ImGui::TextDisabled("No gesture detected yet");
+        ImGui::Text("Devices: %d  Events: %llu (%llu coalesced)  Running commands: %d", status.devices,
+                    (unsigned long long)status.events, (unsigned long long)status.coalesced,
+                    executor.running());
+#ifdef DEBUG
+        ImGui::Text("Hot path allocations: %llu", (unsigned long long)status.allocations);
+#endif
+
+        if (ImGui::CollapsingHeader("Latency (us)")) {
+            if (ImGui::BeginTable("latency", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+                ImGui::TableSetupColumn("Stage");
+                ImGui::TableSetupColumn("Count");
+                ImGui::TableSetupColumn("p50");
+                ImGui::TableSetupColumn("p90");
+                ImGui::TableSetupColumn("p99");
+                ImGui::TableSetupColumn("Max");
+                ImGui::TableHeadersRow();
+                for (size_t i = 0; i < PIPELINE_STATS_ENTRY_COUNT; ++i) {
+                    LatencyHistogram::Summary s = PIPELINE_STATS_ENTRIES[i].histogram->summary();
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%s", PIPELINE_STATS_ENTRIES[i].name);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%llu", (unsigned long long)s.count);
+                    for (uint64_t v : {s.p50, s.p90, s.p99, s.max}) {
+                        ImGui::TableNextColumn();
+                        ImGui::Text("%.1f", v / 1000.0);
+                    }
+                }
+                ImGui::EndTable();
+            }
+        }
+
+        ImGui::End();
+
+        // Typing or dragging: keep drawing until the interaction ends
+        if (ImGui::IsAnyItemActive())
+            settle_frames = SETTLE_FRAMES;
+
+
+        // Rendering
+        ImGui::Render();
+        int display_w, display_h;
+        glfwGetFramebufferSize(window, &display_w, &display_h);
+        glViewport(0, 0, display_w, display_h);
+        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+
+        // Swap waits for vsync, which isn't our cost
+        pipeline_stats.gui_frame.record(monotonic_ns() - frame_start);
+
+        glfwSwapBuffers(window);
+    }
+
+    closing.store(true, std::memory_order_release);
+    events.wake();
+    events_thread.join();
+
+    input.set_status_listener(nullptr);
+    config = editor.config();
+    if (save_at > 0.0)
+        save_binding_store(store_path, config);
+
+    ImGui_ImplOpenGL3_Shutdown();
+    ImGui_ImplGlfw_Shutdown();
+    ImGui::DestroyContext();
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+
+#ifdef __GLIBC__
+    // Most of what the GUI freed would otherwise stay in the heap
+    malloc_trim(0);
+#endif
+
+    return 0;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+
+#include "binding_store.h"
+#include "executor.h"
+#include "input_thread.h"
+#include "reactor.h"
+#include "snapshot.h"
+
+// Runs the ImGui binding editor until the window is closed, the input
+// thread fails or events is stopped. Edits are published to the input
+// thread through snapshot at once and saved to the binding store at
+// store_path once they pause, or when the window closes; config starts the
+// editor and is left holding its final state.
+//
+// The window, its GL context, ImGui and the font atlas exist only for the
+// duration of the call and are all freed before it returns, so the daemon
+// can run on without them. events, the caller's loop, runs on a thread of
+// its own meanwhile, so its signals and requests are handled as they come;
+// stopping it closes the window.
+// Returns non-zero if the window could not be created.
+int run_gui(BindingConfig &config, const std::string &store_path, Snapshot<BindingTable> &snapshot,
+            InputThread &input, Executor &executor, Reactor &events);
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Log-linear latency histogram in the style of HdrHistogram.
+//
+// Values below 32 get a bucket each; above that every power of two is split
+// into 16 linear sub-buckets, bounding the relative error to ~6%. Recording is
+// a handful of relaxed atomic adds, so any thread may record without locks and
+// readers take a consistent-enough copy at any time.
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 5;
+    static constexpr uint64_t SUB_BUCKETS = 1ull << SUB_BUCKET_BITS;
+    static constexpr uint64_t HALF_SUB_BUCKETS = SUB_BUCKETS / 2;
+
+    // Values are clamped to 2^37 - 1 ns (~137 s)
+    static constexpr int MAX_VALUE_BITS = 37;
+    static constexpr uint64_t MAX_VALUE = (1ull << MAX_VALUE_BITS) - 1;
+
+    // bucket_index(MAX_VALUE) + 1
+    static constexpr size_t BUCKET_COUNT = SUB_BUCKETS + (MAX_VALUE_BITS - SUB_BUCKET_BITS) * HALF_SUB_BUCKETS;
+
+    struct Summary {
+        uint64_t count = 0;
+        uint64_t min = 0;
+        uint64_t max = 0;
+        uint64_t mean = 0;
+        uint64_t p50 = 0;
+        uint64_t p90 = 0;
+        uint64_t p99 = 0;
+    };
+
+    void record(uint64_t value)
+    {
+        if (value > MAX_VALUE)
+            value = MAX_VALUE;
+        counts_[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+
+        uint64_t max = max_.load(std::memory_order_relaxed);
+        while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed))
+            ;
+        uint64_t min = min_.load(std::memory_order_relaxed);
+        while (value < min && !min_.compare_exchange_weak(min, value, std::memory_order_relaxed))
+            ;
+    }
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+
+    // Percentiles report the upper edge of the bucket they fall in
+    Summary summary() const
+    {
+        Summary s;
+        uint64_t counts[BUCKET_COUNT];
+        uint64_t total = 0;
+        for (size_t i = 0; i < BUCKET_COUNT; ++i)
+        {
+            counts[i] = counts_[i].load(std::memory_order_relaxed);
+            total += counts[i];
+        }
+        if (total == 0)
+            return s;
+
+        s.count = total;
+        s.min = min_.load(std::memory_order_relaxed);
+        s.max = max_.load(std::memory_order_relaxed);
+        s.mean = sum_.load(std::memory_order_relaxed) / total;
+
+        const double targets[] = {0.50, 0.90, 0.99};
+        uint64_t *outputs[] = {&s.p50, &s.p90, &s.p99};
+        uint64_t seen = 0;
+        int next = 0;
+        for (size_t i = 0; i < BUCKET_COUNT && next < 3; ++i)
+        {
+            seen += counts[i];
+            while (next < 3 && seen >= (uint64_t)(targets[next] * total + 0.5))
+            {
+                uint64_t upper = bucket_upper(i);
+                *outputs[next++] = upper < s.max ? upper : s.max;
+            }
+        }
+        return s;
+    }
+
+    static constexpr size_t bucket_index(uint64_t value)
+    {
+        if (value < SUB_BUCKETS)
+            return (size_t)value;
+        int msb = 63 - __builtin_clzll(value);
+        int shift = msb - (SUB_BUCKET_BITS - 1);
+        return (size_t)(SUB_BUCKETS + (uint64_t)(shift - 1) * HALF_SUB_BUCKETS + ((value >> shift) - HALF_SUB_BUCKETS));
+    }
+
+    static constexpr uint64_t bucket_upper(size_t index)
+    {
+        if (index < SUB_BUCKETS)
+            return index;
+        uint64_t shift = (index - SUB_BUCKETS) / HALF_SUB_BUCKETS + 1;
+        uint64_t sub = (index - SUB_BUCKETS) % HALF_SUB_BUCKETS + HALF_SUB_BUCKETS;
+        return ((sub + 1) << shift) - 1;
+    }
+
+private:
+    std::atomic<uint64_t> counts_[BUCKET_COUNT] = {};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<uint64_t> max_{0};
+    std::atomic<uint64_t> min_{UINT64_MAX};
+};
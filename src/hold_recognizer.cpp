@@ -0,0 +1,30 @@
+#include "hold_recognizer.h"
+
+void HoldRecognizer::begin(int fingers, uint64_t time_us)
+{
+    fingers_ = fingers;
+    begin_us_ = time_us;
+    duration_us_ = 0;
+    active_ = true;
+    moved_ = false;
+}
+
+bool HoldRecognizer::end(uint64_t time_us, bool cancelled, const BindingTable &bindings, GestureKey &key)
+{
+    if (!active_)
+        return false;
+    active_ = false;
+    duration_us_ = time_us > begin_us_ ? time_us - begin_us_ : 0;
+    moved_ = cancelled;
+
+    if (!gesture_fingers_valid(fingers_) || duration_us_ < HOLD_SHORT_US)
+        return false;
+
+    GestureKey short_key = make_gesture_key(fingers_, HoldLength::Short);
+    GestureKey long_key = make_gesture_key(fingers_, HoldLength::Long);
+    if (duration_us_ >= HOLD_LONG_US && (bindings.uses(long_key) || !bindings.uses(short_key)))
+        key = long_key;
+    else
+        key = short_key;
+    return true;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+
+#include "bindings.h"
+#include "gesture.h"
+
+// Hold classifier. The duration comes from the HOLD_BEGIN and HOLD_END event
+// timestamps, so it doesn't depend on when we get round to reading events.
+// A hold libinput cancels because the fingers started moving never runs a
+// binding of its own, but still counts as the start of a sequence.
+class HoldRecognizer {
+public:
+    void begin(int fingers, uint64_t time_us);
+
+    // Returns true if the hold lasted long enough to count; key is set to
+    // the longest length it reached that is bound or part of a sequence,
+    // which may be neither if no length is. See moved() for whether it may
+    // be dispatched.
+    bool end(uint64_t time_us, bool cancelled, const BindingTable &bindings, GestureKey &key);
+
+    // Whether the last hold to end was cancelled by libinput
+    bool moved() const { return moved_; }
+
+    bool active() const { return active_; }
+    int fingers() const { return fingers_; }
+    uint64_t duration_us() const { return duration_us_; }
+
+private:
+    int fingers_ = 0;
+    uint64_t begin_us_ = 0;
+    uint64_t duration_us_ = 0;
+    bool active_ = false;
+    bool moved_ = false;
+};
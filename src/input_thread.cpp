@@ -0,0 +1,751 @@
+#include "input_thread.h"
+
+#include "active_window.h"
+#include "alloc_counter.h"
+#include "clock.h"
+#include "control_server.h"
+#include "event_names.h"
+#include "log.h"
+#include "metrics.h"
+#include "stats.h"
+
+#include <libinput.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string_view>
+
+// How often a recording is written out, unless its buffer fills first
+static const uint64_t TRACE_FLUSH_NS = 1000000000ull;
+
+InputThread::InputThread(struct libinput *li, Snapshot<BindingTable> &bindings, Executor &executor)
+    : li_(li), bindings_(bindings), executor_(executor)
+{
+}
+
+InputThread::~InputThread()
+{
+    stop();
+}
+
+bool InputThread::start()
+{
+    exit_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (exit_fd_ < 0)
+    {
+        LOG(Error) << "Failed to create eventfd: " << std::strerror(errno);
+        return false;
+    }
+    if (!reactor_.open())
+        return false;
+
+    if (!replay_ && !reactor_.add(libinput_get_fd(li_), EPOLLIN, [this](uint32_t) { read_libinput(); }))
+        return false;
+    // Only wakes the loop when the next replayed event is due
+    if (replay_ && !replay_fast_ && (replay_timer_ = reactor_.add_timer([] {})) < 0)
+        return false;
+    if (trace_writer_)
+    {
+        int timer = reactor_.add_timer([this] { trace_writer_->flush(); });
+        if (timer < 0)
+            return false;
+        reactor_.arm_timer(timer, TRACE_FLUSH_NS, TRACE_FLUSH_NS);
+    }
+    if (control_ && !control_->attach(reactor_, local_status_))
+        return false;
+    if (active_window_)
+    {
+        int changed_fd = active_window_->changed_fd();
+        bool added = reactor_.add(changed_fd, EPOLLIN, [this, changed_fd](uint32_t) {
+            uint64_t count;
+            ssize_t ret = read(changed_fd, &count, sizeof(count));
+            (void)ret;
+            select_profile();
+        });
+        if (!added)
+            return false;
+    }
+
+    thread_ = std::thread([this] {
+        apply_thread_scheduling(scheduling_);
+        run();
+        uint64_t one = 1;
+        ssize_t ret = write(exit_fd_, &one, sizeof(one));
+        (void)ret;
+    });
+    return true;
+}
+
+void InputThread::stop()
+{
+    if (thread_.joinable())
+    {
+        reactor_.stop();
+        thread_.join();
+    }
+    if (control_)
+        control_->detach();
+    reactor_.close();
+    if (exit_fd_ >= 0)
+    {
+        close(exit_fd_);
+        exit_fd_ = -1;
+    }
+
+    for (auto &state : devices_)
+    {
+        if (!state->device)
+            continue;
+        libinput_device_set_user_data(state->device, nullptr);
+        libinput_device_unref(state->device);
+    }
+    devices_.clear();
+}
+
+void InputThread::set_replay(const std::vector<TraceEvent> *events, bool fast)
+{
+    replay_ = events;
+    replay_fast_ = fast;
+}
+
+void InputThread::set_status_listener(void (*listener)())
+{
+    std::lock_guard<std::mutex> lock(listener_mutex_);
+    listener_ = listener;
+}
+
+#ifdef DEBUG
+static void check_allocations(GestureStatus &status, uint64_t allocations, std::string_view what)
+{
+    allocations = thread_allocation_count() - allocations;
+    if (allocations != 0)
+    {
+        status.allocations += allocations;
+        LOG(Warn) << "Hot path allocated " << allocations << " time(s) handling " << what;
+    }
+}
+#endif
+
+void InputThread::run()
+{
+    if (replay_)
+    {
+        run_replay();
+        return;
+    }
+
+    while (!reactor_.stopping())
+    {
+        // Nothing from the binding snapshot is held while we sleep
+        bindings_.quiescent();
+
+        if (!reactor_.run_once())
+        {
+            LOG(Error) << "epoll_wait failed: " << std::strerror(errno);
+            failed_.store(true, std::memory_order_release);
+            return;
+        }
+    }
+}
+
+// What lookups go through instead of the snapshot itself. Valid until the
+// next quiescent point, like read().
+const BindingTable &InputThread::active_bindings()
+{
+    uint64_t generation = bindings_.generation();
+    if (generation != seen_generation_)
+    {
+        // Loaded before read(), so a table published in between is picked
+        // up on the next lookup
+        seen_generation_ = generation;
+        const BindingTable &table = *bindings_.read();
+        for (auto &state : devices_)
+            apply_thresholds(*state, table);
+        select_profile();
+    }
+    return profile_ < 0 ? *bindings_.read() : effective_;
+}
+
+void InputThread::select_profile()
+{
+    const BindingTable &table = *bindings_.read();
+
+    int profile = -1;
+    if (active_window_ && !table.profiles.empty())
+    {
+        ActiveApp app = active_window_->current();
+        profile = table.find_profile(app.instance, app.wm_class);
+    }
+
+    if (profile != profile_)
+    {
+        if (profile < 0)
+            LOG(Debug) << "Using the global bindings";
+        else
+            LOG(Debug) << "Using the bindings for " << table.profiles[profile].app;
+    }
+    profile_ = profile;
+    if (profile_ >= 0)
+    {
+        table.overlay(profile_, effective_);
+        effective_.version = table.version;
+    }
+}
+
+// Gestures already under way keep the thresholds they started with
+void InputThread::apply_thresholds(const DeviceState &state, const BindingTable &table)
+{
+    const DeviceThresholds *own = state.info.name.empty() ? nullptr : table.find_device(state.info.name.c_str());
+    engine_.set_thresholds(state.id, own ? own->fingers : default_thresholds(state.info.width_mm, state.info.height_mm));
+}
+
+std::vector<TouchpadInfo> InputThread::touchpads() const
+{
+    std::lock_guard<std::mutex> lock(touchpads_mutex_);
+    return touchpads_;
+}
+
+void InputThread::update_touchpads()
+{
+    std::vector<TouchpadInfo> touchpads;
+    for (const auto &state : devices_)
+    {
+        if (state->device && libinput_device_has_capability(state->device, LIBINPUT_DEVICE_CAP_GESTURE))
+            touchpads.push_back(state->info);
+    }
+
+    std::lock_guard<std::mutex> lock(touchpads_mutex_);
+    touchpads_ = std::move(touchpads);
+    touchpad_generation_.fetch_add(1, std::memory_order_acq_rel);
+}
+
+// Failing this many times in a row means the context is broken rather than
+// having had a bad moment, e.g. a device read failing as it goes away
+static const int DISPATCH_MAX_ERRORS = 10;
+
+// Handles everything one libinput_dispatch yields
+void InputThread::read_libinput()
+{
+    uint64_t dispatch_start = monotonic_ns();
+    int ret = libinput_dispatch(li_);
+    if (ret != 0)
+    {
+        metric_counters.gestures.dispatch_errors.add();
+        if (++dispatch_errors_ < DISPATCH_MAX_ERRORS)
+        {
+            LOG_LIMITED(Warn, 1) << "libinput_dispatch failed: " << std::strerror(-ret);
+            return;
+        }
+        LOG(Error) << "libinput_dispatch failed " << dispatch_errors_ << " times in a row: " << std::strerror(-ret);
+        failed_.store(true, std::memory_order_release);
+        reactor_.stop();
+        return;
+    }
+    dispatch_errors_ = 0;
+
+    uint64_t gestures = local_status_.gestures;
+
+    struct libinput_event *event;
+    while ((event = libinput_get_event(li_)) != NULL)
+    {
+#ifdef DEBUG
+        uint64_t allocations = thread_allocation_count();
+#endif
+        handle_event(event);
+#ifdef DEBUG
+        check_allocations(local_status_, allocations, event_type_name(libinput_event_get_type(event)));
+#endif
+        libinput_event_destroy(event);
+        local_status_.events++;
+        metric_counters.gestures.events.add();
+    }
+
+    finish_batch(dispatch_start, gestures);
+}
+
+// Publishes what a batch of events did; gestures is the count before it
+void InputThread::finish_batch(uint64_t dispatch_start, uint64_t gestures)
+{
+    flush_pending();
+    pipeline_stats.dispatch.record(monotonic_ns() - dispatch_start);
+    status_.store(local_status_);
+
+    if (local_status_.gestures != gestures)
+    {
+        std::lock_guard<std::mutex> lock(listener_mutex_);
+        if (listener_)
+            listener_();
+    }
+}
+
+// Events handed to the recognisers per batch when replaying fast
+static const size_t REPLAY_BATCH = 64;
+
+// Plays the trace back through the same path live events take. Timestamps
+// are moved to start now, so hold durations and, at recorded pace, latency
+// statistics stay meaningful.
+void InputThread::run_replay()
+{
+    const std::vector<TraceEvent> &events = *replay_;
+    uint64_t first_us = events.empty() ? 0 : events[0].time_us;
+    uint64_t start_ns = monotonic_ns();
+    uint64_t start_us = start_ns / 1000;
+
+    size_t i = 0;
+    while (i < events.size() && !reactor_.stopping())
+    {
+        bindings_.quiescent();
+
+        // At recorded pace, sleep until the next event is due; control
+        // clients are served in between either way
+        int timeout = 0;
+        if (!replay_fast_)
+        {
+            uint64_t offset_us = events[i].time_us > first_us ? events[i].time_us - first_us : 0;
+            uint64_t due = start_ns + offset_us * 1000;
+            uint64_t now = monotonic_ns();
+            if (due > now)
+            {
+                reactor_.arm_timer(replay_timer_, due - now);
+                timeout = -1;
+            }
+        }
+        if (!reactor_.run_once(timeout))
+        {
+            LOG(Error) << "epoll_wait failed: " << std::strerror(errno);
+            failed_.store(true, std::memory_order_release);
+            return;
+        }
+        if (reactor_.stopping())
+            return;
+
+        uint64_t dispatch_start = monotonic_ns();
+        uint64_t now = dispatch_start / 1000;
+        uint64_t gestures = local_status_.gestures;
+        size_t batch_start = i;
+        size_t batch_end = replay_fast_ ? std::min(events.size(), i + REPLAY_BATCH) : events.size();
+
+        for (; i < batch_end; ++i)
+        {
+            TraceEvent event = events[i];
+            // A trace concatenated from several recordings may go back in time
+            event.time_us = start_us + (event.time_us > first_us ? event.time_us - first_us : 0);
+            if (!replay_fast_ && event.time_us > now)
+                break;
+#ifdef DEBUG
+            uint64_t allocations = thread_allocation_count();
+#endif
+            replay_event(event);
+#ifdef DEBUG
+            check_allocations(local_status_, allocations, "replayed event");
+#endif
+            local_status_.events++;
+            metric_counters.gestures.events.add();
+        }
+
+        if (i != batch_start)
+            finish_batch(dispatch_start, gestures);
+    }
+
+    double elapsed_ms = (monotonic_ns() - start_ns) / 1e6;
+    LOG(Info) << "Replayed " << events.size() << " events in " << elapsed_ms << " ms ("
+              << (elapsed_ms > 0 ? events.size() / elapsed_ms * 1000.0 : 0.0) << " events/s)";
+}
+
+// device is null for devices in a replayed trace
+InputThread::DeviceState *InputThread::add_device(struct libinput_device *device, uint8_t id)
+{
+    if (device && libinput_device_get_user_data(device))
+        return (DeviceState *)libinput_device_get_user_data(device);
+
+    // The lowest id no connected device holds, so ids are reused once their
+    // device is gone; 0 is the untracked state's
+    if (id == 0)
+    {
+        for (unsigned candidate = 1; candidate <= UINT8_MAX && !id; candidate++)
+        {
+            if (!find_device((uint8_t)candidate))
+                id = (uint8_t)candidate;
+        }
+        if (id == 0)
+        {
+            LOG(Warn) << "Too many devices, not tracking " << libinput_device_get_name(device);
+            return nullptr;
+        }
+    }
+
+    auto state = std::make_unique<DeviceState>();
+    state->id = id;
+    if (device)
+    {
+        state->device = libinput_device_ref(device);
+        libinput_device_set_user_data(device, state.get());
+        state->info.name = libinput_device_get_name(device);
+        if (libinput_device_get_size(device, &state->info.width_mm, &state->info.height_mm) != 0)
+            state->info.width_mm = state->info.height_mm = 0.0;
+        LOG(Info) << "Device added: " << state->info.name << " (" << libinput_device_get_sysname(device) << ")";
+    }
+    else
+    {
+        LOG(Info) << "Device added: replayed device " << (int)id;
+    }
+    apply_thresholds(*state, *bindings_.read());
+    devices_.push_back(std::move(state));
+    local_status_.devices = (int)devices_.size();
+    if (device)
+        update_touchpads();
+    return devices_.back().get();
+}
+
+InputThread::DeviceState *InputThread::find_device(uint8_t id)
+{
+    for (auto &state : devices_)
+    {
+        if (state->id == id)
+            return state.get();
+    }
+    return nullptr;
+}
+
+void InputThread::remove_device(DeviceState &state)
+{
+    for (size_t i = 0; i < devices_.size(); ++i)
+    {
+        if (devices_[i].get() != &state)
+            continue;
+
+        // The id may be handed out again
+        engine_.set_thresholds(state.id, FingerThresholds());
+        bool touchpad = state.device != nullptr;
+        if (struct libinput_device *device = state.device)
+        {
+            LOG(Info) << "Device removed: " << libinput_device_get_name(device)
+                      << " (" << libinput_device_get_sysname(device) << ")";
+            libinput_device_set_user_data(device, nullptr);
+            libinput_device_unref(device);
+        }
+        else
+        {
+            LOG(Info) << "Device removed: replayed device " << (int)state.id;
+        }
+        devices_.erase(devices_.begin() + i);
+        if (touchpad)
+            update_touchpads();
+        break;
+    }
+    local_status_.devices = (int)devices_.size();
+}
+
+// Hands the command bound to key to the executor. event_time is the
+// triggering event's libinput timestamp.
+void InputThread::dispatch(GestureKey key, uint64_t event_time)
+{
+    // Hand off before logging so the print doesn't add latency
+    const CommandRef &command = active_bindings()[key];
+    if (command && !dry_run_ && !executor_.submit(command, event_time))
+        metric_counters.gestures.dropped.add();
+    pipeline_stats.recognition.record(ns_since_us(event_time));
+    (command ? metric_counters.gestures.bound : metric_counters.gestures.unbound)[key].add();
+
+    LOG(Info) << "Detected " << gesture_fingers(key) << "-finger " << gesture_kind_name(gesture_kind(key))
+              << " " << gesture_variant_name(key);
+    if (!command)
+        LOG(Info) << "No binding found for this gesture";
+
+    local_status_.gestures++;
+    local_status_.last_gesture = key;
+    local_status_.last_bound = command != nullptr;
+    if (control_)
+        control_->publish(key, command != nullptr);
+}
+
+// Gestures go on to the sequences whether or not they are bound themselves,
+// and a bound one has already run by the time a sequence completes
+void InputThread::match_sequence(GestureKey key, uint64_t event_time)
+{
+    const SequenceMatcher *matcher = active_bindings().matcher.get();
+    if (!matcher)
+        return;
+
+    const SequenceBinding *sequence = matcher->feed(sequence_state_, key, event_time);
+    if (!sequence)
+        return;
+    if (!dry_run_ && !executor_.submit(sequence->command, event_time))
+        metric_counters.gestures.dropped.add();
+    metric_counters.gestures.sequences.add();
+
+    if (log_enabled(LogLevel::Info))
+    {
+        LogLine line(LogLevel::Info);
+        line << "Detected sequence";
+        for (size_t i = 0; i < sequence->keys.size(); ++i)
+        {
+            GestureKey step = sequence->keys[i];
+            line << (i ? ", " : " ") << gesture_kind_name(gesture_kind(step)) << " " << gesture_fingers(step) << " "
+                 << gesture_variant_name(step);
+        }
+    }
+}
+
+// A streaming binding took over a gesture; only counted once, not per step
+void InputThread::begin_stream(GestureKey key, uint64_t event_time)
+{
+    pipeline_stats.recognition.record(ns_since_us(event_time));
+    metric_counters.gestures.bound[key].add();
+
+    LOG(Info) << "Streaming " << gesture_fingers(key) << "-finger " << gesture_kind_name(gesture_kind(key))
+              << " " << gesture_variant_name(key);
+
+    local_status_.gestures++;
+    local_status_.last_gesture = key;
+    local_status_.last_bound = true;
+    if (control_)
+        control_->publish(key, true);
+}
+
+void InputThread::stream(GestureKey key, int steps)
+{
+    // The binding may have changed mid-gesture
+    const CommandRef &command = active_bindings()[key];
+    if (command && command->options.stream && !dry_run_)
+        executor_.submit_stream(command, key, steps);
+}
+
+// Reduces a libinput event to what the recognisers need; false for events
+// they ignore
+static bool translate_event(struct libinput_event *event, TraceEvent &trace)
+{
+    trace = TraceEvent();
+    switch (libinput_event_get_type(event))
+    {
+        case LIBINPUT_EVENT_DEVICE_ADDED:
+            trace.type = TraceEventType::DeviceAdded;
+            trace.time_us = monotonic_us();
+            return true;
+
+        case LIBINPUT_EVENT_DEVICE_REMOVED:
+            trace.type = TraceEventType::DeviceRemoved;
+            trace.time_us = monotonic_us();
+            return true;
+
+        // Finger scrolls come in pointer motion units. libinput has no
+        // unaccelerated scroll value, so these keep their acceleration.
+        case LIBINPUT_EVENT_POINTER_AXIS:
+        {
+            struct libinput_event_pointer *pointer_event = libinput_event_get_pointer_event(event);
+            trace.type = TraceEventType::Scroll;
+            trace.time_us = libinput_event_pointer_get_time_usec(pointer_event);
+            if (libinput_event_pointer_get_axis_source(pointer_event) == LIBINPUT_POINTER_AXIS_SOURCE_FINGER)
+                trace.flags |= TRACE_SCROLL_FINGER;
+            if (libinput_event_pointer_has_axis(pointer_event, LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL))
+            {
+                trace.flags |= TRACE_SCROLL_V;
+                double value = libinput_event_pointer_get_axis_value(pointer_event, LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL);
+                trace.dy = (float)(value * LIBINPUT_UNIT_MM);
+            }
+            if (libinput_event_pointer_has_axis(pointer_event, LIBINPUT_POINTER_AXIS_SCROLL_HORIZONTAL))
+            {
+                trace.flags |= TRACE_SCROLL_H;
+                double value = libinput_event_pointer_get_axis_value(pointer_event, LIBINPUT_POINTER_AXIS_SCROLL_HORIZONTAL);
+                trace.dx = (float)(value * LIBINPUT_UNIT_MM);
+            }
+            return true;
+        }
+
+        case LIBINPUT_EVENT_GESTURE_SWIPE_BEGIN: trace.type = TraceEventType::SwipeBegin; break;
+        case LIBINPUT_EVENT_GESTURE_SWIPE_UPDATE: trace.type = TraceEventType::SwipeUpdate; break;
+        case LIBINPUT_EVENT_GESTURE_SWIPE_END: trace.type = TraceEventType::SwipeEnd; break;
+        case LIBINPUT_EVENT_GESTURE_PINCH_BEGIN: trace.type = TraceEventType::PinchBegin; break;
+        case LIBINPUT_EVENT_GESTURE_PINCH_UPDATE: trace.type = TraceEventType::PinchUpdate; break;
+        case LIBINPUT_EVENT_GESTURE_PINCH_END: trace.type = TraceEventType::PinchEnd; break;
+        case LIBINPUT_EVENT_GESTURE_HOLD_BEGIN: trace.type = TraceEventType::HoldBegin; break;
+        case LIBINPUT_EVENT_GESTURE_HOLD_END: trace.type = TraceEventType::HoldEnd; break;
+
+        default:
+            return false;
+    }
+
+    struct libinput_event_gesture *gesture_event = libinput_event_get_gesture_event(event);
+    trace.time_us = libinput_event_gesture_get_time_usec(gesture_event);
+    trace.fingers = (uint8_t)libinput_event_gesture_get_finger_count(gesture_event);
+    switch (trace.type)
+    {
+        // Unaccelerated, so a swipe's length doesn't depend on its speed
+        case TraceEventType::SwipeUpdate:
+            trace.dx = (float)(libinput_event_gesture_get_dx_unaccelerated(gesture_event) * LIBINPUT_UNIT_MM);
+            trace.dy = (float)(libinput_event_gesture_get_dy_unaccelerated(gesture_event) * LIBINPUT_UNIT_MM);
+            break;
+        case TraceEventType::PinchUpdate:
+            trace.dx = (float)(libinput_event_gesture_get_dx_unaccelerated(gesture_event) * LIBINPUT_UNIT_MM);
+            trace.dy = (float)(libinput_event_gesture_get_dy_unaccelerated(gesture_event) * LIBINPUT_UNIT_MM);
+            trace.scale = (float)libinput_event_gesture_get_scale(gesture_event);
+            break;
+        case TraceEventType::SwipeEnd:
+        case TraceEventType::PinchEnd:
+        case TraceEventType::HoldEnd:
+            if (libinput_event_gesture_get_cancelled(gesture_event))
+                trace.flags |= TRACE_CANCELLED;
+            break;
+        default:
+            break;
+    }
+    return true;
+}
+
+void InputThread::handle_event(struct libinput_event *event)
+{
+    TraceEvent trace;
+    if (!translate_event(event, trace))
+    {
+        LOG(Trace) << "Event: " << event_type_name(libinput_event_get_type(event));
+        return;
+    }
+
+    // How long the event waited for us, which is what scheduling options
+    // change; device events carry no kernel timestamp
+    if (trace.type != TraceEventType::DeviceAdded && trace.type != TraceEventType::DeviceRemoved)
+        pipeline_stats.wakeup.record(ns_since_us(trace.time_us));
+
+    struct libinput_device *device = libinput_event_get_device(event);
+    DeviceState *state;
+    if (trace.type == TraceEventType::DeviceAdded)
+    {
+        state = add_device(device, 0);
+        if (state)
+        {
+            trace.dx = (float)state->info.width_mm;
+            trace.dy = (float)state->info.height_mm;
+        }
+    }
+    else
+        state = (DeviceState *)libinput_device_get_user_data(device);
+    if (!state)
+        state = &untracked_;
+
+    trace.device = state->id;
+    if (trace_writer_)
+        trace_writer_->append(trace);
+    ingest(trace);
+    if (trace.type == TraceEventType::DeviceRemoved && state != &untracked_)
+        remove_device(*state);
+}
+
+void InputThread::replay_event(const TraceEvent &event)
+{
+    DeviceState *state = find_device(event.device);
+    // A device the recording daemon had no id left for stays untracked
+    if (!state && event.type == TraceEventType::DeviceAdded && event.device != 0)
+    {
+        // Recorded with its size, so it gets the same default thresholds
+        DeviceState *added = add_device(nullptr, event.device);
+        added->info.width_mm = event.dx;
+        added->info.height_mm = event.dy;
+        apply_thresholds(*added, *bindings_.read());
+    }
+    ingest(event);
+    if (state && event.type == TraceEventType::DeviceRemoved)
+        remove_device(*state);
+}
+
+void InputThread::ingest(const TraceEvent &event)
+{
+    if (has_pending_ && coalesce_update(pending_, event))
+    {
+        local_status_.coalesced++;
+        return;
+    }
+    flush_pending();
+    pending_ = event;
+    has_pending_ = true;
+}
+
+void InputThread::flush_pending()
+{
+    if (!has_pending_)
+        return;
+    has_pending_ = false;
+    process(pending_);
+}
+
+void InputThread::process(const TraceEvent &event)
+{
+    GestureEngine::Output recognized;
+    size_t count = engine_.feed(event, active_bindings(), recognized);
+    if (log_enabled(LogLevel::Debug))
+        print_event(event);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const RecognizedGesture &gesture = recognized[i];
+        switch (gesture.type)
+        {
+            case RecognizedType::Fire:
+                dispatch(gesture.key, gesture.time_us);
+                match_sequence(gesture.key, gesture.time_us);
+                break;
+            case RecognizedType::Moved:
+                match_sequence(gesture.key, gesture.time_us);
+                break;
+            case RecognizedType::StreamStart:
+                begin_stream(gesture.key, gesture.time_us);
+                break;
+            case RecognizedType::Stream:
+                stream(gesture.key, gesture.steps);
+                break;
+            case RecognizedType::Reversed:
+                metric_counters.gestures.reversed[gesture.key].add();
+                LOG(Info) << "Swipe reversed, cancelled";
+                break;
+            case RecognizedType::Short:
+                metric_counters.gestures.fell_short[gesture.key].add();
+                break;
+        }
+    }
+}
+
+// Per update lines are limited, since a touchpad may send hundreds a second
+void InputThread::print_event(const TraceEvent &event) const
+{
+    const GestureEngine::Device &device = engine_.device(event.device);
+    switch (event.type)
+    {
+        case TraceEventType::SwipeBegin:
+            LOG(Debug) << "Swipe gesture started with " << device.swipe.fingers() << " fingers";
+            break;
+        case TraceEventType::SwipeUpdate:
+            LOG_LIMITED(Trace, 50) << "Swipe update: dx=" << device.swipe.dx() << ", dy=" << device.swipe.dy();
+            break;
+        case TraceEventType::SwipeEnd:
+            LOG(Debug) << "Swipe gesture (" << device.swipe.fingers() << " fingers) ended with dx="
+                      << device.swipe.dx() << ", dy=" << device.swipe.dy();
+            break;
+        case TraceEventType::Scroll:
+            if (event.flags & TRACE_SCROLL_FINGER)
+                LOG_LIMITED(Trace, 50) << "2-finger scroll: h=" << event.dx << ", v=" << event.dy;
+            break;
+        case TraceEventType::PinchBegin:
+            LOG(Debug) << "Pinch gesture started with " << device.pinch.fingers() << " fingers";
+            break;
+        case TraceEventType::PinchUpdate:
+            LOG_LIMITED(Trace, 50) << "Pinch update: scale=" << device.pinch.scale() << ", dx=" << device.pinch.dx()
+                      << ", dy=" << device.pinch.dy();
+            break;
+        case TraceEventType::PinchEnd:
+            LOG(Debug) << "Pinch gesture ended with total scale=" << device.pinch.scale()
+                      << ", dx=" << device.pinch.dx() << ", dy=" << device.pinch.dy();
+            break;
+        case TraceEventType::HoldBegin:
+            LOG(Debug) << "Hold gesture started with " << device.hold.fingers() << " finger(s)";
+            break;
+        case TraceEventType::HoldEnd:
+            LOG(Debug) << "Hold gesture ended with " << device.hold.fingers() << " finger(s) after "
+                      << device.hold.duration_us() / 1000 << "ms";
+            break;
+        default:
+            break;
+    }
+}
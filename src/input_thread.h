@@ -0,0 +1,190 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bindings.h"
+#include "executor.h"
+#include "gesture_engine.h"
+#include "reactor.h"
+#include "seqlock.h"
+#include "snapshot.h"
+#include "thread_priority.h"
+#include "trace.h"
+
+class ActiveWindow;
+class ControlServer;
+
+struct libinput;
+struct libinput_event;
+struct libinput_device;
+
+// What the input thread reports back to the GUI.
+struct GestureStatus {
+    uint64_t events = 0;
+    int devices = 0;
+    uint64_t gestures = 0;
+    uint64_t coalesced = 0;     // updates folded into the one before them
+    uint64_t allocations = 0;   // heap allocations while handling events (debug builds)
+    GestureKey last_gesture = 0;
+    bool last_bound = false;
+};
+
+// A connected touchpad, for settings that are kept per device
+struct TouchpadInfo {
+    std::string name;       // libinput device name
+    double width_mm = 0.0;  // 0 if libinput doesn't know the size
+    double height_mm = 0.0;
+};
+
+// Owns the libinput event loop. Sleeps in a Reactor on the libinput fd (and
+// the control socket, if any) in its own thread so gesture handling is not
+// tied to the GUI's frame rate. Works with both path
+// and udev contexts; devices may come and go at runtime and each keeps its
+// own gesture state.
+//
+// Every libinput event is first reduced to a TraceEvent and fed to a
+// GestureEngine, so the thread can equally be driven from a recorded trace.
+// What the engine recognises is handed to the executor from here, and fed
+// on to the sequence matcher.
+//
+// Consecutive motion updates within one libinput_dispatch batch are merged
+// (see coalesce_update) before the engine sees them, so a batch of updates
+// from a high-rate touchpad costs one recognizer pass. Traces are recorded
+// before merging.
+class InputThread {
+public:
+    InputThread(struct libinput *li, Snapshot<BindingTable> &bindings, Executor &executor);
+    ~InputThread();
+
+    bool start();
+    void stop();
+
+    // Set when libinput_dispatch keeps failing; the thread exits afterwards.
+    bool failed() const { return failed_.load(std::memory_order_acquire); }
+
+    GestureStatus status() const { return status_.load(); }
+
+    // Connected devices that report gestures. touchpad_generation() changes
+    // whenever the list does, so callers can keep a copy.
+    std::vector<TouchpadInfo> touchpads() const;
+    uint64_t touchpad_generation() const { return touchpad_generation_.load(std::memory_order_acquire); }
+
+    // Called from the input thread whenever status() gains a new gesture,
+    // e.g. to wake an idle GUI. Pass nullptr to remove.
+    void set_status_listener(void (*listener)());
+
+    // Becomes readable once the thread has exited on its own
+    int exit_fd() const { return exit_fd_; }
+
+    // Appends every handled event to writer, which must outlive the thread.
+    // Set before start().
+    void set_trace_writer(TraceWriter *writer) { trace_writer_ = writer; }
+
+    // Feeds events instead of reading libinput (li may then be null), with
+    // the recorded pacing or, if fast, as quickly as possible. The thread
+    // exits once the trace is done. Set before start().
+    void set_replay(const std::vector<TraceEvent> *events, bool fast);
+
+    // Recognise gestures but never run their commands
+    void set_dry_run(bool dry_run) { dry_run_ = dry_run; }
+
+    // Serves control clients from this thread and tells its subscribers
+    // about every gesture. Must outlive the thread; set before start().
+    void set_control_server(ControlServer *control) { control_ = control; }
+
+    // Lays the focused application's profile over the global bindings.
+    // Must outlive the thread; set before start().
+    void set_active_window(ActiveWindow *window) { active_window_ = window; }
+
+    // Applied to the input thread once it starts; other threads keep the
+    // default. Set before start().
+    void set_scheduling(const SchedulingOptions &options) { scheduling_ = options; }
+
+private:
+    // Attached as libinput device user data; the gesture state itself is
+    // the engine's, under id
+    struct DeviceState {
+        struct libinput_device *device = nullptr;   // null when replaying
+        uint8_t id = 0;                             // TraceEvent::device
+        TouchpadInfo info;                          // empty name when replaying
+    };
+
+    void run();
+    const BindingTable &active_bindings();
+    void select_profile();
+    void apply_thresholds(const DeviceState &state, const BindingTable &table);
+    void update_touchpads();
+    void run_replay();
+    void read_libinput();
+    void finish_batch(uint64_t dispatch_start, uint64_t gestures);
+    void handle_event(struct libinput_event *event);
+    void replay_event(const TraceEvent &event);
+    void ingest(const TraceEvent &event);
+    void flush_pending();
+    void process(const TraceEvent &event);
+    void print_event(const TraceEvent &event) const;
+    void dispatch(GestureKey key, uint64_t event_time);
+    void match_sequence(GestureKey key, uint64_t event_time);
+    void begin_stream(GestureKey key, uint64_t event_time);
+    void stream(GestureKey key, int steps);
+    // id 0 picks the lowest free one; null once all 255 are taken
+    DeviceState *add_device(struct libinput_device *device, uint8_t id);
+    DeviceState *find_device(uint8_t id);
+    void remove_device(DeviceState &state);
+
+    struct libinput *li_;
+    Snapshot<BindingTable> &bindings_;
+    Executor &executor_;
+
+    GestureEngine engine_;
+
+    // Last event of the batch, held back in case the next one merges into it
+    TraceEvent pending_;
+    bool has_pending_ = false;
+    std::vector<std::unique_ptr<DeviceState>> devices_;
+
+    // Used for events from a device we never saw added
+    DeviceState untracked_;
+
+    TraceWriter *trace_writer_ = nullptr;
+    const std::vector<TraceEvent> *replay_ = nullptr;
+    bool replay_fast_ = false;
+    bool dry_run_ = false;
+    ControlServer *control_ = nullptr;
+    ActiveWindow *active_window_ = nullptr;
+    SchedulingOptions scheduling_;
+
+    // The bindings for the focused application, rebuilt when either the
+    // application or the table changes; unused while profile_ is -1
+    BindingTable effective_;
+    int profile_ = -1;
+    uint64_t seen_generation_ = UINT64_MAX;
+
+    // Where recognised gestures have got to in the active bindings' sequences
+    SequenceState sequence_state_;
+
+    GestureStatus local_status_;
+    SeqLock<GestureStatus> status_;
+
+    mutable std::mutex touchpads_mutex_;
+    std::vector<TouchpadInfo> touchpads_;
+    std::atomic<uint64_t> touchpad_generation_{0};
+
+    std::mutex listener_mutex_;
+    void (*listener_)() = nullptr;
+
+    // libinput_dispatch failures since the last success
+    int dispatch_errors_ = 0;
+
+    std::thread thread_;
+    Reactor reactor_;
+    int replay_timer_ = -1;
+    int exit_fd_ = -1;
+    std::atomic<bool> failed_{false};
+};
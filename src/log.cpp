@@ -0,0 +1,316 @@
+#include "log.h"
+
+#include "clock.h"
+#include "ring_buffer.h"
+
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+// Debug builds keep printing what they always did
+#ifdef DEBUG
+std::atomic<uint8_t> log_threshold{(uint8_t)LogLevel::Trace};
+#else
+std::atomic<uint8_t> log_threshold{(uint8_t)LogLevel::Info};
+#endif
+
+static const char *const LOG_LEVEL_NAMES[] = {"error", "warn", "info", "debug", "trace"};
+
+void set_log_level(LogLevel level)
+{
+    log_threshold.store((uint8_t)level, std::memory_order_relaxed);
+}
+
+LogLevel log_level()
+{
+    return (LogLevel)log_threshold.load(std::memory_order_relaxed);
+}
+
+bool parse_log_level(const std::string &text, LogLevel &level)
+{
+    for (size_t i = 0; i < sizeof(LOG_LEVEL_NAMES) / sizeof(LOG_LEVEL_NAMES[0]); ++i)
+    {
+        if (text == LOG_LEVEL_NAMES[i])
+        {
+            level = (LogLevel)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *log_level_name(LogLevel level)
+{
+    return LOG_LEVEL_NAMES[(size_t)level];
+}
+
+bool LogRateLimit::allow(uint64_t &suppressed)
+{
+    uint64_t now = monotonic_ns();
+    uint64_t start = window_start_ns_.load(std::memory_order_relaxed);
+    if (now - start >= 1000000000ull && window_start_ns_.compare_exchange_strong(start, now, std::memory_order_relaxed))
+        window_count_.store(0, std::memory_order_relaxed);
+
+    if (window_count_.fetch_add(1, std::memory_order_relaxed) >= per_second_)
+    {
+        suppressed_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+    return true;
+}
+
+struct LogRecord {
+    LogLevel level;
+    uint16_t length;
+    char text[LOG_LINE_MAX];
+};
+
+// Room for a burst of a few hundred lines; ~250 KiB
+static BoundedQueue<LogRecord, 1024> log_queue;
+
+static std::thread writer_thread;
+static int writer_wake_fd = -1;
+static std::atomic<bool> writer_running{false};
+static std::atomic<bool> writer_stopping{false};
+static std::atomic<bool> writer_sleeping{false};
+static std::atomic<uint64_t> dropped_lines{0};
+
+// Under systemd, prefix lines with their syslog priority so the journal
+// keeps the level
+static bool journal_prefix = false;
+
+static const char JOURNAL_PRIORITIES[][4] = {"<3>", "<4>", "<6>", "<7>", "<7>"};
+
+// Collects lines for one fd and writes them with as few calls as possible
+struct LogOutput {
+    int fd;
+    size_t used = 0;
+    char data[16384];
+
+    explicit LogOutput(int fd) : fd(fd) {}
+
+    void add(const LogRecord &record)
+    {
+        size_t needed = record.length + 4 + 1;
+        if (used + needed > sizeof(data))
+            flush();
+        if (journal_prefix)
+        {
+            std::memcpy(data + used, JOURNAL_PRIORITIES[(size_t)record.level], 3);
+            used += 3;
+        }
+        std::memcpy(data + used, record.text, record.length);
+        used += record.length;
+        data[used++] = '\n';
+    }
+
+    void flush()
+    {
+        size_t done = 0;
+        while (done < used)
+        {
+            ssize_t written = write(fd, data + done, used - done);
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written <= 0)
+                break;
+            done += (size_t)written;
+        }
+        used = 0;
+    }
+};
+
+static int record_fd(const LogRecord &record)
+{
+    return record.level <= LogLevel::Warn ? STDERR_FILENO : STDOUT_FILENO;
+}
+
+static void write_now(const LogRecord &record)
+{
+    LogOutput output(record_fd(record));
+    output.add(record);
+    output.flush();
+}
+
+static void submit(const LogRecord &record)
+{
+    if (!writer_running.load(std::memory_order_acquire))
+    {
+        write_now(record);
+        return;
+    }
+
+    if (!log_queue.push(record))
+    {
+        dropped_lines.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // Pairs with the fence in writer_loop: either it sees our record or we
+    // see that it went to sleep
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (writer_sleeping.exchange(false, std::memory_order_relaxed))
+    {
+        uint64_t one = 1;
+        ssize_t ret = write(writer_wake_fd, &one, sizeof(one));
+        (void)ret;
+    }
+}
+
+static void writer_loop()
+{
+    static LogOutput out(STDOUT_FILENO);
+    static LogOutput err(STDERR_FILENO);
+    struct pollfd wake = {writer_wake_fd, POLLIN, 0};
+
+    while (true)
+    {
+        LogRecord record;
+        while (log_queue.pop(record))
+            (record_fd(record) == STDERR_FILENO ? err : out).add(record);
+
+        uint64_t dropped = dropped_lines.exchange(0, std::memory_order_relaxed);
+        if (dropped)
+        {
+            record.level = LogLevel::Warn;
+            record.length = (uint16_t)std::snprintf(record.text, sizeof(record.text),
+                                                    "Log queue full, dropped %llu line(s)",
+                                                    (unsigned long long)dropped);
+            err.add(record);
+        }
+        out.flush();
+        err.flush();
+
+        if (writer_stopping.load(std::memory_order_acquire))
+            return;
+
+        writer_sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (log_queue.pop(record))
+        {
+            writer_sleeping.store(false, std::memory_order_relaxed);
+            (record_fd(record) == STDERR_FILENO ? err : out).add(record);
+            continue;
+        }
+
+        if (poll(&wake, 1, -1) > 0)
+        {
+            uint64_t value;
+            ssize_t ret = read(writer_wake_fd, &value, sizeof(value));
+            (void)ret;
+        }
+        writer_sleeping.store(false, std::memory_order_relaxed);
+    }
+}
+
+LogWriter::LogWriter()
+{
+    journal_prefix = std::getenv("JOURNAL_STREAM") != nullptr;
+
+    writer_wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (writer_wake_fd < 0)
+    {
+        LOG(Warn) << "Failed to create eventfd, logging synchronously: " << std::strerror(errno);
+        return;
+    }
+
+    // The writer must never take signals meant for signalfd or the GUI
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    writer_stopping.store(false, std::memory_order_relaxed);
+    writer_thread = std::thread(writer_loop);
+    pthread_sigmask(SIG_SETMASK, &old, nullptr);
+    writer_running.store(true, std::memory_order_release);
+}
+
+LogWriter::~LogWriter()
+{
+    if (!writer_thread.joinable())
+        return;
+
+    // Lines from threads still running go straight out from here on
+    writer_running.store(false, std::memory_order_release);
+    writer_stopping.store(true, std::memory_order_release);
+    uint64_t one = 1;
+    ssize_t ret = write(writer_wake_fd, &one, sizeof(one));
+    (void)ret;
+    writer_thread.join();
+
+    // Pushed between the writer's last look and it stopping
+    LogRecord record;
+    while (log_queue.pop(record))
+        write_now(record);
+
+    close(writer_wake_fd);
+    writer_wake_fd = -1;
+}
+
+LogLine::LogLine(LogLevel level)
+    : level_(level)
+{
+}
+
+LogLine::LogLine(LogLevel level, LogRateLimit &limit)
+    : level_(level)
+{
+    discard_ = !limit.allow(suppressed_);
+}
+
+LogLine::~LogLine()
+{
+    if (discard_)
+        return;
+    if (suppressed_)
+        *this << " (" << suppressed_ << " similar line(s) suppressed)";
+
+    LogRecord record;
+    record.level = level_;
+    record.length = (uint16_t)length_;
+    std::memcpy(record.text, text_, length_);
+    submit(record);
+}
+
+LogLine &LogLine::operator<<(std::string_view text)
+{
+    if (discard_)
+        return *this;
+    size_t n = std::min(text.size(), sizeof(text_) - length_);
+    std::memcpy(text_ + length_, text.data(), n);
+    length_ += n;
+    return *this;
+}
+
+// Same as an ostream's default format
+LogLine &LogLine::operator<<(double value)
+{
+    if (discard_)
+        return *this;
+    char buffer[32];
+    int n = std::snprintf(buffer, sizeof(buffer), "%g", value);
+    return *this << std::string_view(buffer, n > 0 ? (size_t)n : 0);
+}
+
+LogLine &LogLine::append_signed(long long value)
+{
+    char buffer[24];
+    int n = std::snprintf(buffer, sizeof(buffer), "%lld", value);
+    return *this << std::string_view(buffer, (size_t)n);
+}
+
+LogLine &LogLine::append_unsigned(unsigned long long value)
+{
+    char buffer[24];
+    int n = std::snprintf(buffer, sizeof(buffer), "%llu", value);
+    return *this << std::string_view(buffer, (size_t)n);
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Buffered logging. LOG(Info) << ... formats into a fixed-size record on the
+// caller's stack and pushes it onto a lock-free queue; a LogWriter thread
+// writes the records out, so a slow stdout (journald, a pipe nobody reads)
+// never stalls the input or executor threads. Errors and warnings go to
+// stderr, everything else to stdout. With no LogWriter running, lines are
+// written synchronously.
+//
+// When the queue is full, lines are dropped and counted rather than waited
+// for.
+enum class LogLevel : uint8_t {
+    Error = 0,
+    Warn,
+    Info,
+    Debug,      // per gesture detail
+    Trace,      // per event detail
+};
+
+// Longest line kept; longer ones are cut short
+constexpr size_t LOG_LINE_MAX = 240;
+
+extern std::atomic<uint8_t> log_threshold;
+
+inline bool log_enabled(LogLevel level)
+{
+    return (uint8_t)level <= log_threshold.load(std::memory_order_relaxed);
+}
+
+// Lines above level are discarded before they are formatted
+void set_log_level(LogLevel level);
+LogLevel log_level();
+
+// "error", "warn", "info", "debug" or "trace"
+bool parse_log_level(const std::string &text, LogLevel &level);
+const char *log_level_name(LogLevel level);
+
+// Lets through at most per_second lines a second from one call site; the
+// next line let through says how many were suppressed
+class LogRateLimit {
+public:
+    explicit LogRateLimit(int per_second) : per_second_(per_second) {}
+
+    // Returns false to suppress; otherwise sets suppressed to the number of
+    // lines dropped since the last one let through
+    bool allow(uint64_t &suppressed);
+
+private:
+    int per_second_;
+    std::atomic<uint64_t> window_start_ns_{0};
+    std::atomic<int> window_count_{0};
+    std::atomic<uint64_t> suppressed_{0};
+};
+
+// One line, submitted when it goes out of scope
+class LogLine {
+public:
+    explicit LogLine(LogLevel level);
+    // Discarded, without formatting, if limit says so
+    LogLine(LogLevel level, LogRateLimit &limit);
+    ~LogLine();
+
+    LogLine(const LogLine &) = delete;
+    LogLine &operator=(const LogLine &) = delete;
+
+    LogLine &operator<<(std::string_view text);
+    LogLine &operator<<(const char *text) { return *this << std::string_view(text ? text : "(null)"); }
+    LogLine &operator<<(const std::string &text) { return *this << std::string_view(text); }
+    LogLine &operator<<(char c) { return *this << std::string_view(&c, 1); }
+    LogLine &operator<<(double value);
+
+    template <typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+    LogLine &operator<<(T value)
+    {
+        if (discard_)
+            return *this;
+        if (std::is_signed<T>::value)
+            return append_signed((long long)value);
+        return append_unsigned((unsigned long long)value);
+    }
+
+private:
+    LogLine &append_signed(long long value);
+    LogLine &append_unsigned(unsigned long long value);
+
+    LogLevel level_;
+    bool discard_ = false;
+    uint64_t suppressed_ = 0;
+    size_t length_ = 0;
+    char text_[LOG_LINE_MAX];
+};
+
+// Turns LOG's stream expression into void for the ?: below
+struct LogVoidify {
+    void operator&(const LogLine &) {}
+};
+
+// A single expression, so it is safe after an unbraced if; nothing after
+// the << is evaluated unless the level is enabled
+#define LOG(level) \
+    !log_enabled(LogLevel::level) ? (void)0 : LogVoidify() & LogLine(LogLevel::level)
+
+// For lines that can come per event: at most per_second of them a second
+// from this call site. Each lambda has its own static limit.
+#define LOG_LIMITED(level, per_second) \
+    !log_enabled(LogLevel::level) ? (void)0 : LogVoidify() & \
+        LogLine(LogLevel::level, []() -> LogRateLimit & { static LogRateLimit limit(per_second); return limit; }())
+
+// Runs the background writer for its lifetime; lines still queued are
+// written out before the destructor returns
+class LogWriter {
+public:
+    LogWriter();
+    ~LogWriter();
+
+    LogWriter(const LogWriter &) = delete;
+    LogWriter &operator=(const LogWriter &) = delete;
+};
@@ -0,0 +1,111 @@
+#include "metrics.h"
+
+#include "stats.h"
+
+#include <cstdio>
+
+MetricCounters metric_counters;
+
+static const char PREFIX[] = "gesture_daemon_";
+
+static void append_header(std::string &out, const char *name, const char *type, const char *help)
+{
+    char line[256];
+    std::snprintf(line, sizeof(line), "# TYPE %s%s %s\n# HELP %s%s %s\n", PREFIX, name, type, PREFIX, name, help);
+    out += line;
+}
+
+static void append_counter(std::string &out, const char *name, const char *help, uint64_t value)
+{
+    append_header(out, name, "counter", help);
+    char line[128];
+    std::snprintf(line, sizeof(line), "%s%s_total %llu\n", PREFIX, name, (unsigned long long)value);
+    out += line;
+}
+
+// One sample per gesture key that has happened at all; total(key) gives
+// its value
+template <typename Total>
+static void append_key_counter(std::string &out, const char *name, const char *help, Total total)
+{
+    append_header(out, name, "counter", help);
+    char line[256];
+    for (size_t key = 0; key < GESTURE_KEY_COUNT; ++key)
+    {
+        uint64_t value = total((GestureKey)key);
+        if (value == 0)
+            continue;
+        std::snprintf(line, sizeof(line), "%s%s_total{kind=\"%s\",fingers=\"%d\",variant=\"%s\"} %llu\n", PREFIX,
+                      name, gesture_kind_name(gesture_kind((GestureKey)key)), gesture_fingers((GestureKey)key),
+                      gesture_variant_name((GestureKey)key), (unsigned long long)value);
+        out += line;
+    }
+}
+
+// labels is empty or "name=\"value\","; values are nanoseconds, exported
+// in seconds
+static void append_summary_samples(std::string &out, const char *name, const char *labels,
+                                   const LatencyHistogram &histogram)
+{
+    LatencyHistogram::Summary s = histogram.summary();
+    char line[256];
+    const double quantiles[] = {0.5, 0.9, 0.99};
+    const uint64_t values[] = {s.p50, s.p90, s.p99};
+    for (size_t i = 0; i < 3; ++i)
+    {
+        std::snprintf(line, sizeof(line), "%s%s{%squantile=\"%g\"} %.9g\n", PREFIX, name, labels, quantiles[i],
+                      values[i] / 1e9);
+        out += line;
+    }
+
+    // Without the trailing comma, or no braces at all
+    std::string bare(labels);
+    if (!bare.empty())
+        bare = "{" + bare.substr(0, bare.size() - 1) + "}";
+    std::snprintf(line, sizeof(line), "%s%s_sum%s %.9g\n%s%s_count%s %llu\n", PREFIX, name, bare.c_str(),
+                  histogram.sum() / 1e9, PREFIX, name, bare.c_str(), (unsigned long long)s.count);
+    out += line;
+}
+
+void format_openmetrics(std::string &out)
+{
+    const GestureCounters &gestures = metric_counters.gestures;
+    const ExecutorCounters &executor = metric_counters.executor;
+
+    append_key_counter(out, "gestures_recognized", "Gestures recognised, bound or not.",
+                       [&](GestureKey key) { return gestures.bound[key].value() + gestures.unbound[key].value(); });
+    append_key_counter(out, "gestures_bound", "Gestures that ran their binding or started a stream.",
+                       [&](GestureKey key) { return gestures.bound[key].value(); });
+    append_key_counter(out, "gestures_unbound", "Gestures recognised with nothing bound.",
+                       [&](GestureKey key) { return gestures.unbound[key].value(); });
+    append_key_counter(out, "gestures_short", "Swipes, scrolls and pinches that ended short of their threshold.",
+                       [&](GestureKey key) { return gestures.fell_short[key].value(); });
+    append_key_counter(out, "gestures_reversed", "Swipes pulled back and discarded.",
+                       [&](GestureKey key) { return gestures.reversed[key].value(); });
+    append_counter(out, "sequences", "Gesture sequences completed.", gestures.sequences.value());
+    append_counter(out, "events", "libinput events handled.", gestures.events.value());
+    append_counter(out, "dispatch_errors", "libinput_dispatch failures.", gestures.dispatch_errors.value());
+    append_counter(out, "commands_dropped", "Commands the executor queue or drop policy turned away.",
+                   gestures.dropped.value());
+
+    append_counter(out, "commands_spawned", "Command processes started.", executor.spawned.value());
+    append_counter(out, "command_spawn_failures", "Commands that failed to start.", executor.spawn_failures.value());
+    append_counter(out, "actions", "Built-in actions run.", executor.actions.value());
+    append_counter(out, "action_failures", "Built-in actions that failed.", executor.action_failures.value());
+    append_counter(out, "commands_throttled", "Commands discarded by a debounce or rate limit.",
+                   executor.throttled.value());
+    append_counter(out, "commands_coalesced", "Commands folded into one already waiting.",
+                   executor.coalesced.value());
+
+    append_header(out, "command_duration_seconds", "summary", "Command processes from spawn to exit.");
+    append_summary_samples(out, "command_duration_seconds", "", executor.command_duration);
+
+    append_header(out, "latency_seconds", "summary", "Gesture pipeline latency by stage.");
+    for (size_t i = 0; i < PIPELINE_STATS_ENTRY_COUNT; ++i)
+    {
+        std::string labels = std::string("stage=\"") + PIPELINE_STATS_ENTRIES[i].name + "\",";
+        append_summary_samples(out, "latency_seconds", labels.c_str(), *PIPELINE_STATS_ENTRIES[i].histogram);
+    }
+
+    out += "# EOF\n";
+}
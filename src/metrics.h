@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "gesture.h"
+#include "histogram.h"
+
+// Event counter with a single writing thread: an increment is a relaxed
+// load and store, with no locked instruction, and any thread may read it.
+// A second writer would only lose counts.
+class Counter {
+public:
+    void add(uint64_t n = 1) { value_.store(value_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+// Counted by the input thread
+struct GestureCounters {
+    Counter bound[GESTURE_KEY_COUNT];       // recognised and ran a binding (or started a stream)
+    Counter unbound[GESTURE_KEY_COUNT];     // recognised with nothing bound
+    Counter fell_short[GESTURE_KEY_COUNT];  // ended short of its threshold
+    Counter reversed[GESTURE_KEY_COUNT];    // pulled back and discarded
+    Counter sequences;                      // sequence bindings completed
+    Counter events;                         // libinput events handled
+    Counter dispatch_errors;                // libinput_dispatch failures
+    Counter dropped;                        // commands the executor turned away
+};
+
+// Counted by the executor thread
+struct ExecutorCounters {
+    Counter spawned;            // processes started
+    Counter spawn_failures;     // posix_spawn errors
+    Counter actions;            // built-in actions that succeeded
+    Counter action_failures;
+    Counter throttled;          // jobs a debounce or rate limit discarded
+    Counter coalesced;          // jobs folded into a waiting one
+    LatencyHistogram command_duration;  // spawn to exit, nanoseconds
+};
+
+// Each block is only ever written by the thread it's named for; exporting
+// reads them all, so the hot paths never share a counter or take a lock.
+struct MetricCounters {
+    GestureCounters gestures;
+    ExecutorCounters executor;
+};
+
+extern MetricCounters metric_counters;
+
+// The counters and pipeline_stats in the OpenMetrics text format, ending
+// with "# EOF". Totals such as recognised gestures are summed here rather
+// than counted separately.
+void format_openmetrics(std::string &out);
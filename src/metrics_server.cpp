@@ -0,0 +1,212 @@
+#include "metrics_server.h"
+
+#include "clock.h"
+#include "log.h"
+#include "metrics.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+// Scrapers are few; more than this at once are turned away
+static const size_t MAX_CLIENTS = 8;
+
+// Request headers beyond this are not worth reading
+static const size_t MAX_REQUEST = 8192;
+
+// How long a client gets to send its request, and to take the response
+static const uint64_t REQUEST_TIMEOUT_NS = 5000000000ull;
+static const int SEND_TIMEOUT_S = 1;
+
+MetricsServer::~MetricsServer()
+{
+    stop();
+}
+
+bool MetricsServer::start(uint16_t port)
+{
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (listen_fd_ < 0)
+    {
+        LOG(Error) << "Failed to create metrics socket: " << std::strerror(errno);
+        return false;
+    }
+
+    int one = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    // Loopback only: the counters say what the user is doing
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listen_fd_, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_fd_, 16) != 0)
+    {
+        LOG(Error) << "Failed to listen for metrics on 127.0.0.1:" << port << ": " << std::strerror(errno);
+        stop();
+        return false;
+    }
+
+    if (!reactor_.open() ||
+        !reactor_.add(listen_fd_, EPOLLIN, [this](uint32_t) { accept_clients(); }) ||
+        (expire_timer_ = reactor_.add_timer([this] { expire_clients(); })) < 0)
+    {
+        stop();
+        return false;
+    }
+
+    thread_ = std::thread([this] { reactor_.run(); });
+    LOG(Info) << "Serving metrics on http://127.0.0.1:" << port << "/metrics";
+    return true;
+}
+
+void MetricsServer::stop()
+{
+    if (thread_.joinable())
+    {
+        reactor_.stop();
+        thread_.join();
+    }
+    reactor_.close();
+    expire_timer_ = -1;
+    for (const Client &client : clients_)
+        close(client.fd);
+    clients_.clear();
+    if (listen_fd_ >= 0)
+    {
+        close(listen_fd_);
+        listen_fd_ = -1;
+    }
+}
+
+void MetricsServer::accept_clients()
+{
+    while (true)
+    {
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+        if (fd < 0)
+            return;
+
+        if (clients_.size() >= MAX_CLIENTS || !reactor_.add(fd, EPOLLIN, [this, fd](uint32_t) { read_client(fd); }))
+        {
+            close(fd);
+            continue;
+        }
+
+        Client client;
+        client.fd = fd;
+        client.opened_ns = monotonic_ns();
+        clients_.push_back(std::move(client));
+        if (clients_.size() == 1)
+            reactor_.arm_timer(expire_timer_, REQUEST_TIMEOUT_NS / 5, REQUEST_TIMEOUT_NS / 5);
+    }
+}
+
+void MetricsServer::read_client(int fd)
+{
+    size_t index = 0;
+    while (index < clients_.size() && clients_[index].fd != fd)
+        ++index;
+    if (index == clients_.size())
+        return;
+
+    Client &client = clients_[index];
+    char buffer[4096];
+    while (true)
+    {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        if (n <= 0)
+        {
+            remove_client(index);
+            return;
+        }
+        client.in.append(buffer, (size_t)n);
+    }
+
+    // The body, if any, doesn't matter
+    if (client.in.find("\r\n\r\n") != std::string::npos || client.in.find("\n\n") != std::string::npos)
+    {
+        respond(client);
+        remove_client(index);
+    }
+    else if (client.in.size() > MAX_REQUEST)
+    {
+        remove_client(index);
+    }
+}
+
+static std::string response(const char *status, const char *type, const std::string &body)
+{
+    std::string out = std::string("HTTP/1.1 ") + status + "\r\nContent-Type: " + type +
+                      "\r\nContent-Length: " + std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n";
+    out += body;
+    return out;
+}
+
+void MetricsServer::respond(Client &client)
+{
+    const std::string &request = client.in;
+    std::string out;
+    if (request.compare(0, 4, "GET ") != 0)
+    {
+        out = response("405 Method Not Allowed", "text/plain", "GET only\n");
+    }
+    else if (request.compare(4, 9, "/metrics ") != 0 && request.compare(4, 9, "/metrics?") != 0)
+    {
+        out = response("404 Not Found", "text/plain", "Try /metrics\n");
+    }
+    else
+    {
+        std::string body;
+        format_openmetrics(body);
+        out = response("200 OK", "application/openmetrics-text; version=1.0.0; charset=utf-8", body);
+    }
+
+    // Small enough to just block for, within a limit
+    int flags = fcntl(client.fd, F_GETFL);
+    fcntl(client.fd, F_SETFL, flags & ~O_NONBLOCK);
+    struct timeval timeout = {SEND_TIMEOUT_S, 0};
+    setsockopt(client.fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    size_t done = 0;
+    while (done < out.size())
+    {
+        ssize_t n = send(client.fd, out.data() + done, out.size() - done, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        done += (size_t)n;
+    }
+}
+
+void MetricsServer::remove_client(size_t index)
+{
+    reactor_.remove(clients_[index].fd);
+    close(clients_[index].fd);
+    clients_[index] = std::move(clients_.back());
+    clients_.pop_back();
+    if (clients_.empty())
+        reactor_.arm_timer(expire_timer_, 0);
+}
+
+void MetricsServer::expire_clients()
+{
+    uint64_t now = monotonic_ns();
+    // Backwards, so remove_client() can swap-remove
+    for (size_t i = clients_.size(); i-- > 0;)
+    {
+        if (now - clients_[i].opened_ns > REQUEST_TIMEOUT_NS)
+            remove_client(i);
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "reactor.h"
+
+// Minimal HTTP endpoint for Prometheus-style scrapers: GET /metrics on
+// 127.0.0.1 answers with format_openmetrics(), and anything else with 404.
+// Runs on a thread of its own, so a scrape costs the input thread nothing;
+// the counters it reads are written without locks by their own threads.
+//
+// One request per connection. A client that hasn't sent its request within
+// a few seconds is hung up on.
+class MetricsServer {
+public:
+    MetricsServer() = default;
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer &) = delete;
+    MetricsServer &operator=(const MetricsServer &) = delete;
+
+    bool start(uint16_t port);
+    void stop();
+
+private:
+    struct Client {
+        int fd = -1;
+        uint64_t opened_ns = 0;
+        std::string in;
+    };
+
+    void accept_clients();
+    void read_client(int fd);
+    void respond(Client &client);
+    void remove_client(size_t index);
+    void expire_clients();
+
+    Reactor reactor_;
+    int listen_fd_ = -1;
+    int expire_timer_ = -1;
+    std::vector<Client> clients_;
+    std::thread thread_;
+};
@@ -0,0 +1,77 @@
+#include "pinch_recognizer.h"
+
+#include <algorithm>
+
+// Scale change, in percent, before a streaming binding takes the pinch over
+static const double STREAM_LOCK_PERCENT = 3.0;
+
+void PinchRecognizer::begin(int fingers, double in_scale, double out_scale)
+{
+    *this = PinchRecognizer();
+    fingers_ = fingers;
+    in_scale_ = in_scale;
+    out_scale_ = out_scale;
+    active_ = true;
+}
+
+void PinchRecognizer::update(double scale, double dx, double dy, const BindingTable &bindings)
+{
+    scale_ = scale;
+    dx_ += dx;
+    dy_ += dy;
+
+    if (streaming_ || !gesture_fingers_valid(fingers_))
+        return;
+
+    PinchDirection dir = scale_ >= 1.0 ? PinchDirection::Out : PinchDirection::In;
+    GestureKey candidate = make_gesture_key(fingers_, dir);
+    const CommandRef &command = bindings[candidate];
+    if (!command || !command->options.stream || travel(dir) < STREAM_LOCK_PERCENT)
+        return;
+
+    streaming_ = true;
+    stream_key_ = candidate;
+    double step = command->options.stream_step > 0.0 ? command->options.stream_step : STREAM_STEP_PERCENT;
+    stream_step_ = std::max(step, 1.0);
+}
+
+bool PinchRecognizer::end(bool cancelled, GestureKey &key)
+{
+    active_ = false;
+    if (cancelled || streaming_ || !gesture_fingers_valid(fingers_))
+        return false;
+
+    if (scale_ > out_scale_)
+        key = make_gesture_key(fingers_, PinchDirection::Out);
+    else if (scale_ < in_scale_)
+        key = make_gesture_key(fingers_, PinchDirection::In);
+    else
+    {
+        if (scale_ != 1.0)
+        {
+            key = make_gesture_key(fingers_, scale_ > 1.0 ? PinchDirection::Out : PinchDirection::In);
+            fell_short_ = true;
+        }
+        return false;
+    }
+    return true;
+}
+
+int PinchRecognizer::take_stream_steps()
+{
+    if (!streaming_)
+        return 0;
+
+    // Quantise the total rather than each update so rounding doesn't drift
+    int total = (int)(travel((PinchDirection)gesture_variant(stream_key_)) / stream_step_);
+    int steps = total - streamed_steps_;
+    streamed_steps_ = total;
+    return steps;
+}
+
+// Scale change towards dir, in percent
+double PinchRecognizer::travel(PinchDirection dir) const
+{
+    double percent = (scale_ - 1.0) * 100.0;
+    return dir == PinchDirection::Out ? percent : -percent;
+}
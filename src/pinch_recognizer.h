@@ -0,0 +1,56 @@
+#pragma once
+
+#include "bindings.h"
+#include "gesture.h"
+
+// Pinch classifier. libinput reports the scale relative to PINCH_BEGIN, so
+// the latest value is the total.
+//
+// A pinch resolves to IN or OUT at PINCH_END from its final scale. A
+// streaming binding takes over once the scale has moved a few percent its
+// way; from then on the change in scale, in percent, is quantised into
+// steps for take_stream_steps() and nothing fires.
+class PinchRecognizer {
+public:
+    // The final scale must be below in_scale or above out_scale to count
+    void begin(int fingers, double in_scale = PINCH_IN_SCALE, double out_scale = PINCH_OUT_SCALE);
+
+    void update(double scale, double dx, double dy, const BindingTable &bindings);
+
+    // Returns true if the finished pinch should be dispatched; key is set to
+    // the recognised gesture, which may be unbound. One whose scale stayed
+    // between the two sets fell_short() and key to the way it went.
+    bool end(bool cancelled, GestureKey &key);
+
+    bool fell_short() const { return fell_short_; }
+
+    bool active() const { return active_; }
+    int fingers() const { return fingers_; }
+    double scale() const { return scale_; }
+    double dx() const { return dx_; }
+    double dy() const { return dy_; }
+
+    bool streaming() const { return streaming_; }
+    GestureKey stream_key() const { return stream_key_; }
+
+    // Whole steps moved in the streamed direction since the last call;
+    // negative when moving back
+    int take_stream_steps();
+
+private:
+    double travel(PinchDirection dir) const;
+
+    int fingers_ = 0;
+    double in_scale_ = PINCH_IN_SCALE;
+    double out_scale_ = PINCH_OUT_SCALE;
+    double scale_ = 1.0;
+    double dx_ = 0.0;
+    double dy_ = 0.0;
+    bool active_ = false;
+    bool fell_short_ = false;
+
+    bool streaming_ = false;
+    GestureKey stream_key_ = 0;
+    double stream_step_ = 0.0;
+    int streamed_steps_ = 0;
+};
@@ -0,0 +1,219 @@
+#include "reactor.h"
+
+#include "log.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+// Events taken per epoll_wait; more stay ready for the next call
+static const int MAX_EVENTS = 32;
+
+Reactor::~Reactor()
+{
+    close();
+}
+
+bool Reactor::open()
+{
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (epoll_fd_ < 0 || wake_fd_ < 0)
+    {
+        LOG(Error) << "Failed to create event loop: " << std::strerror(errno);
+        close();
+        return false;
+    }
+
+    stopping_.store(false, std::memory_order_relaxed);
+    int wake_fd = wake_fd_;
+    return add(wake_fd_, EPOLLIN, [wake_fd](uint32_t) {
+        uint64_t count;
+        ssize_t ret = read(wake_fd, &count, sizeof(count));
+        (void)ret;
+    });
+}
+
+void Reactor::close()
+{
+    for (int fd : owned_fds_)
+        ::close(fd);
+    owned_fds_.clear();
+    entries_.clear();
+    retired_.clear();
+    if (wake_fd_ >= 0)
+    {
+        ::close(wake_fd_);
+        wake_fd_ = -1;
+    }
+    if (epoll_fd_ >= 0)
+    {
+        ::close(epoll_fd_);
+        epoll_fd_ = -1;
+    }
+}
+
+bool Reactor::add(int fd, uint32_t events, Handler handler)
+{
+    if (fd < 0)
+        return false;
+    if ((size_t)fd >= entries_.size())
+        entries_.resize(fd + 1);
+    if (entries_[fd])
+        retired_.push_back(std::move(entries_[fd]));
+
+    auto entry = std::make_unique<Entry>();
+    entry->handler = std::move(handler);
+    entry->serial = next_serial_++;
+
+    struct epoll_event event = {};
+    event.events = events;
+    event.data.u64 = ((uint64_t)entry->serial << 32) | (uint32_t)fd;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0 &&
+        (errno != EEXIST || epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event) != 0))
+    {
+        LOG(Error) << "Failed to watch fd " << fd << ": " << std::strerror(errno);
+        return false;
+    }
+
+    entries_[fd] = std::move(entry);
+    return true;
+}
+
+bool Reactor::modify(int fd, uint32_t events)
+{
+    if (fd < 0 || (size_t)fd >= entries_.size() || !entries_[fd])
+        return false;
+
+    struct epoll_event event = {};
+    event.events = events;
+    event.data.u64 = ((uint64_t)entries_[fd]->serial << 32) | (uint32_t)fd;
+    return epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event) == 0;
+}
+
+void Reactor::remove(int fd)
+{
+    if (fd < 0 || (size_t)fd >= entries_.size() || !entries_[fd])
+        return;
+
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    // The handler may be the one running; it is freed after the batch
+    retired_.push_back(std::move(entries_[fd]));
+}
+
+int Reactor::add_timer(std::function<void()> handler)
+{
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (fd < 0)
+    {
+        LOG(Error) << "Failed to create timerfd: " << std::strerror(errno);
+        return -1;
+    }
+
+    bool added = add(fd, EPOLLIN, [fd, handler = std::move(handler)](uint32_t) {
+        uint64_t expirations;
+        if (read(fd, &expirations, sizeof(expirations)) == sizeof(expirations))
+            handler();
+    });
+    if (!added)
+    {
+        ::close(fd);
+        return -1;
+    }
+    owned_fds_.push_back(fd);
+    return fd;
+}
+
+void Reactor::arm_timer(int timer, uint64_t delay_ns, uint64_t interval_ns)
+{
+    struct itimerspec spec = {};
+    spec.it_value.tv_sec = (time_t)(delay_ns / 1000000000ull);
+    spec.it_value.tv_nsec = (long)(delay_ns % 1000000000ull);
+    spec.it_interval.tv_sec = (time_t)(interval_ns / 1000000000ull);
+    spec.it_interval.tv_nsec = (long)(interval_ns % 1000000000ull);
+    timerfd_settime(timer, 0, &spec, nullptr);
+}
+
+void Reactor::remove_timer(int timer)
+{
+    auto it = std::find(owned_fds_.begin(), owned_fds_.end(), timer);
+    if (it == owned_fds_.end())
+        return;
+    remove(timer);
+    ::close(timer);
+    owned_fds_.erase(it);
+}
+
+bool Reactor::add_signals(const sigset_t &signals, std::function<void(int signo)> handler)
+{
+    int fd = signalfd(-1, &signals, SFD_CLOEXEC | SFD_NONBLOCK);
+    if (fd < 0)
+    {
+        LOG(Error) << "Failed to create signalfd: " << std::strerror(errno);
+        return false;
+    }
+
+    bool added = add(fd, EPOLLIN, [fd, handler = std::move(handler)](uint32_t) {
+        struct signalfd_siginfo info;
+        while (read(fd, &info, sizeof(info)) == sizeof(info))
+            handler((int)info.ssi_signo);
+    });
+    if (!added)
+    {
+        ::close(fd);
+        return false;
+    }
+    owned_fds_.push_back(fd);
+    return true;
+}
+
+void Reactor::wake()
+{
+    uint64_t one = 1;
+    ssize_t ret = write(wake_fd_, &one, sizeof(one));
+    (void)ret;
+}
+
+void Reactor::stop()
+{
+    stopping_.store(true, std::memory_order_release);
+    wake();
+}
+
+bool Reactor::run_once(int timeout_ms)
+{
+    struct epoll_event events[MAX_EVENTS];
+    int n = epoll_wait(epoll_fd_, events, MAX_EVENTS, timeout_ms);
+    if (n < 0)
+        return errno == EINTR;
+
+    for (int i = 0; i < n; ++i)
+    {
+        uint32_t fd = (uint32_t)events[i].data.u64;
+        uint32_t serial = (uint32_t)(events[i].data.u64 >> 32);
+        Entry *entry = fd < entries_.size() ? entries_[fd].get() : nullptr;
+        // Removed, or replaced, by an earlier handler in this batch
+        if (!entry || entry->serial != serial)
+            continue;
+        entry->handler(events[i].events);
+    }
+
+    retired_.clear();
+    return true;
+}
+
+bool Reactor::run()
+{
+    while (!stopping())
+    {
+        if (!run_once(-1))
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <signal.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// epoll event loop for one thread. File descriptors, timers (timerfd) and
+// signals (signalfd) are registered with a handler, and run_once() sleeps
+// until one of them is ready and calls its handler, so a thread built on it
+// wakes only for real work. Handlers run on the thread calling run_once()
+// and may add or remove registrations, their own included.
+//
+// Everything but wake() and stop() must be called from that thread, or
+// before it starts.
+class Reactor {
+public:
+    // Gets the epoll events that fired
+    using Handler = std::function<void(uint32_t events)>;
+
+    Reactor() = default;
+    ~Reactor();
+
+    Reactor(const Reactor &) = delete;
+    Reactor &operator=(const Reactor &) = delete;
+
+    bool open();
+    void close();
+
+    // fd stays the caller's. A registered fd that is closed silently drops
+    // out of epoll; adding its number again replaces the stale handler.
+    bool add(int fd, uint32_t events, Handler handler);
+    bool modify(int fd, uint32_t events);
+    void remove(int fd);
+
+    // One timer per call; -1 on failure. It fires delay_ns after arming and
+    // then every interval_ns if that isn't 0. A delay of 0 disarms it.
+    int add_timer(std::function<void()> handler);
+    void arm_timer(int timer, uint64_t delay_ns, uint64_t interval_ns = 0);
+    void remove_timer(int timer);
+
+    // The signals must already be blocked in every thread
+    bool add_signals(const sigset_t &signals, std::function<void(int signo)> handler);
+
+    // Any thread: makes a sleeping run_once() return
+    void wake();
+
+    // Any thread: makes run() return after the current handler
+    void stop();
+    bool stopping() const { return stopping_.load(std::memory_order_acquire); }
+
+    // Waits up to timeout_ms (-1 = forever) and runs the handlers that are
+    // ready. False if epoll_wait failed.
+    bool run_once(int timeout_ms = -1);
+
+    // run_once() until stop()
+    bool run();
+
+private:
+    struct Entry {
+        Handler handler;
+        uint32_t serial;    // tells a reused fd number from the one an event was for
+    };
+
+    std::vector<std::unique_ptr<Entry>> entries_;   // indexed by fd
+    std::vector<std::unique_ptr<Entry>> retired_;   // removed during run_once()
+    std::vector<int> owned_fds_;                    // timers and signalfds
+    uint32_t next_serial_ = 1;
+
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+    std::atomic<bool> stopping_{false};
+};
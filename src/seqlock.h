@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Single-writer sequence lock for small trivially-copyable structs.
+// Readers never block the writer; they retry if a store raced with them.
+template <typename T>
+class SeqLock {
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock requires a trivially copyable type");
+
+public:
+    void store(const T& value)
+    {
+        uint64_t seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(&value_, &value, sizeof(T));
+        std::atomic_thread_fence(std::memory_order_release);
+        seq_.store(seq + 2, std::memory_order_relaxed);
+    }
+
+    T load() const
+    {
+        T copy;
+        uint64_t before, after;
+        do {
+            before = seq_.load(std::memory_order_acquire);
+            std::memcpy(&copy, &value_, sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = seq_.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+        return copy;
+    }
+
+private:
+    std::atomic<uint64_t> seq_{0};
+    T value_{};
+};
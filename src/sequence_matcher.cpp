@@ -0,0 +1,158 @@
+#include "sequence_matcher.h"
+
+#include <algorithm>
+#include <atomic>
+
+// So a SequenceState can tell matchers apart even if one is allocated where
+// a freed one was
+static std::atomic<uint64_t> next_matcher_id{1};
+
+// Marks a missing trie edge while building
+static const uint32_t NO_EDGE = UINT32_MAX;
+
+void set_sequence(std::vector<SequenceBinding> &sequences, SequenceBinding binding)
+{
+    for (SequenceBinding &existing : sequences)
+    {
+        if (existing.keys == binding.keys)
+        {
+            existing = std::move(binding);
+            return;
+        }
+    }
+    sequences.push_back(std::move(binding));
+}
+
+bool erase_sequence(std::vector<SequenceBinding> &sequences, const std::vector<GestureKey> &keys)
+{
+    auto it = std::find_if(sequences.begin(), sequences.end(),
+                           [&](const SequenceBinding &binding) { return binding.keys == keys; });
+    if (it == sequences.end())
+        return false;
+    sequences.erase(it);
+    return true;
+}
+
+SequenceMatcher::SequenceMatcher(const std::vector<const SequenceBinding *> &sequences)
+    : id_(next_matcher_id.fetch_add(1, std::memory_order_relaxed))
+{
+    for (const SequenceBinding *binding : sequences)
+    {
+        if (binding->keys.size() >= 2 && binding->keys.size() <= SEQUENCE_MAX_LENGTH && binding->command)
+            set_sequence(sequences_, *binding);
+    }
+
+    for (const SequenceBinding &binding : sequences_)
+    {
+        for (GestureKey key : binding.keys)
+        {
+            if (!column_[key])
+                column_[key] = (uint16_t)columns_++;
+        }
+    }
+
+    // The trie; ending[s] is the sequence spelled by the path to s, or -1
+    next_.assign(columns_, NO_EDGE);
+    std::vector<int64_t> ending(1, -1);
+    for (size_t i = 0; i < sequences_.size(); ++i)
+    {
+        uint32_t state = 0;
+        for (GestureKey key : sequences_[i].keys)
+        {
+            size_t edge = state * columns_ + column_[key];
+            if (next_[edge] == NO_EDGE)
+            {
+                next_[edge] = (uint32_t)ending.size();
+                ending.push_back(-1);
+                next_.resize(next_.size() + columns_, NO_EDGE);
+            }
+            state = next_[edge];
+        }
+        ending[state] = (int64_t)i;
+    }
+
+    // Breadth first, so a state's failure link, being shallower, already
+    // has its full row: a missing edge goes wherever the failure link's does
+    std::vector<uint32_t> fail(ending.size(), 0);
+    std::vector<uint32_t> order;
+    order.reserve(ending.size());
+    for (size_t column = 0; column < columns_; ++column)
+    {
+        if (next_[column] == NO_EDGE)
+            next_[column] = 0;
+        else
+            order.push_back(next_[column]);
+    }
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        uint32_t state = order[i];
+        for (size_t column = 0; column < columns_; ++column)
+        {
+            uint32_t &edge = next_[state * columns_ + column];
+            uint32_t via_fail = next_[fail[state] * columns_ + column];
+            if (edge == NO_EDGE)
+            {
+                edge = via_fail;
+            }
+            else
+            {
+                fail[edge] = via_fail;
+                order.push_back(edge);
+            }
+        }
+    }
+
+    // A state also ends every sequence its failure link does; those are
+    // shorter, so appending them keeps the longest first
+    std::vector<std::vector<uint32_t>> outputs(ending.size());
+    for (uint32_t state : order)
+    {
+        if (ending[state] >= 0)
+            outputs[state].push_back((uint32_t)ending[state]);
+        const std::vector<uint32_t> &inherited = outputs[fail[state]];
+        outputs[state].insert(outputs[state].end(), inherited.begin(), inherited.end());
+    }
+    outputs_begin_.push_back(0);
+    for (const std::vector<uint32_t> &ends : outputs)
+    {
+        outputs_.insert(outputs_.end(), ends.begin(), ends.end());
+        outputs_begin_.push_back((uint32_t)outputs_.size());
+    }
+}
+
+// Whether the last length gestures fed came no more than window_us apart
+static bool within_window(const SequenceState &state, size_t length, uint64_t window_us)
+{
+    for (size_t back = 1; back < length; ++back)
+    {
+        uint64_t later = state.times_us[(state.count - back) % SEQUENCE_MAX_LENGTH];
+        uint64_t earlier = state.times_us[(state.count - back - 1) % SEQUENCE_MAX_LENGTH];
+        if (later > earlier && later - earlier > window_us)
+            return false;
+    }
+    return true;
+}
+
+const SequenceBinding *SequenceMatcher::feed(SequenceState &state, GestureKey key, uint64_t time_us) const
+{
+    if (state.matcher != id_)
+    {
+        state = SequenceState();
+        state.matcher = id_;
+    }
+
+    state.state = next_[state.state * columns_ + column_[key]];
+    state.times_us[state.count % SEQUENCE_MAX_LENGTH] = time_us;
+    state.count++;
+
+    for (uint32_t i = outputs_begin_[state.state]; i < outputs_begin_[state.state + 1]; ++i)
+    {
+        const SequenceBinding &binding = sequences_[outputs_[i]];
+        if (within_window(state, binding.keys.size(), binding.window_ms * 1000ull))
+        {
+            state.state = 0;
+            return &binding;
+        }
+    }
+    return nullptr;
+}
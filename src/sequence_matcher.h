@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "command.h"
+#include "gesture.h"
+
+// Most gestures one sequence binding can chain
+constexpr size_t SEQUENCE_MAX_LENGTH = 8;
+
+// Longest pause between two gestures of a sequence that sets no window
+constexpr uint32_t SEQUENCE_WINDOW_MS = 500;
+
+// Gestures bound as a run, e.g. a 3-finger swipe up and then one left. Each
+// must be recognised within window_ms of the one before it, going by the
+// events' timestamps. A hold the fingers moved on from counts as well, so a
+// sequence starting with a hold is a hold-then-swipe chord.
+struct SequenceBinding {
+    std::vector<GestureKey> keys;   // 2 to SEQUENCE_MAX_LENGTH
+    uint32_t window_ms = SEQUENCE_WINDOW_MS;
+    CommandRef command;
+};
+
+// Binds into sequences, replacing any run of the same gestures
+void set_sequence(std::vector<SequenceBinding> &sequences, SequenceBinding binding);
+
+// False if no sequence has exactly these gestures
+bool erase_sequence(std::vector<SequenceBinding> &sequences, const std::vector<GestureKey> &keys);
+
+// How far the recognised gestures have got through a SequenceMatcher. Owned
+// by whoever feeds it; a state fed to a different matcher starts over.
+struct SequenceState {
+    uint64_t matcher = 0;                           // SequenceMatcher id
+    uint32_t state = 0;
+    uint32_t count = 0;                             // gestures fed
+    uint64_t times_us[SEQUENCE_MAX_LENGTH] = {};    // of the last ones, by count
+};
+
+// Sequence bindings compiled into a DFA over gesture keys: an Aho-Corasick
+// trie with its failure links folded into a full transition table, so each
+// gesture costs one table load however many sequences there are, and a run
+// that breaks off part way still matches a sequence starting inside it.
+// Keys no sequence uses share one column, which keeps the table small.
+//
+// Built whenever the sequences change and immutable after that, so tables
+// share it the way they share a CommandRef.
+class SequenceMatcher {
+public:
+    // Of two sequences with the same gestures, the later one wins
+    explicit SequenceMatcher(const std::vector<const SequenceBinding *> &sequences);
+
+    // Feeds the next recognised gesture. Returns the longest sequence it
+    // completes whose pauses all fit its window, or null; completing one
+    // starts the run over.
+    const SequenceBinding *feed(SequenceState &state, GestureKey key, uint64_t time_us) const;
+
+    // True if any sequence contains key
+    bool uses(GestureKey key) const { return column_[key] != 0; }
+
+    size_t sequence_count() const { return sequences_.size(); }
+    size_t state_count() const { return outputs_begin_.size() - 1; }
+
+private:
+    uint64_t id_;
+    std::vector<SequenceBinding> sequences_;
+    uint16_t column_[GESTURE_KEY_COUNT] = {};   // 0 for keys in no sequence
+    size_t columns_ = 1;
+    std::vector<uint32_t> next_;                // state * columns_ + column
+    // outputs_[outputs_begin_[s], outputs_begin_[s + 1]) are the sequences
+    // ending at state s, longest first
+    std::vector<uint32_t> outputs_begin_;
+    std::vector<uint32_t> outputs_;
+};
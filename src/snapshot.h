@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Single-reader RCU cell.
+//
+// Writers (any thread) publish immutable values; they are serialised by a
+// mutex that the reader never touches. The reader thread loads the current
+// value lock-free and calls quiescent() whenever it no longer holds a pointer
+// it obtained from read() - typically right before it blocks for more input.
+// Retired values are freed once the reader has passed a quiescent point.
+//
+// T has a uint64_t version, which publish() sets to one more than that of
+// the value it replaces, so every writer numbers its values the same way.
+template <typename T>
+class Snapshot {
+public:
+    Snapshot() : current_(new T()) {}
+    explicit Snapshot(std::unique_ptr<T> initial) : current_(initial.release()) {}
+
+    ~Snapshot()
+    {
+        delete current_.load();
+        for (const Retired& r : retired_)
+            delete r.value;
+    }
+
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+
+    // Reader side. The pointer stays valid until the next quiescent() call.
+    const T* read() const { return current_.load(std::memory_order_acquire); }
+
+    void quiescent()
+    {
+        reader_generation_.store(generation_.load(std::memory_order_acquire),
+                                 std::memory_order_release);
+    }
+
+    // Writer side.
+    void publish(std::unique_ptr<T> value)
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        publish_locked(std::move(value));
+    }
+
+    // Writer side, for an edit of the current value: edit(T&) changes a copy
+    // of it and the copy is published, all under the writer lock, so no other
+    // writer's value can land in between and be undone. Nothing is published
+    // if edit returns false.
+    template <typename Edit>
+    bool update(Edit edit)
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        auto value = std::make_unique<T>(*current_.load(std::memory_order_acquire));
+        if (!edit(*value))
+            return false;
+        publish_locked(std::move(value));
+        return true;
+    }
+
+    // Writer side, for a thread other than the reader to start editing from
+    // the current value.
+    std::unique_ptr<T> copy()
+    {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        return std::make_unique<T>(*current_.load(std::memory_order_acquire));
+    }
+
+    uint64_t generation() const { return generation_.load(std::memory_order_acquire); }
+
+private:
+    struct Retired {
+        T* value;
+        uint64_t generation;
+    };
+
+    void publish_locked(std::unique_ptr<T> value)
+    {
+        value->version = current_.load(std::memory_order_relaxed)->version + 1;
+        T* old = current_.exchange(value.release(), std::memory_order_acq_rel);
+        uint64_t generation = generation_.fetch_add(1, std::memory_order_acq_rel) + 1;
+        retired_.push_back({old, generation});
+        reclaim_locked();
+    }
+
+    void reclaim_locked()
+    {
+        uint64_t seen = reader_generation_.load(std::memory_order_acquire);
+        auto it = retired_.begin();
+        while (it != retired_.end()) {
+            if (it->generation <= seen) {
+                delete it->value;
+                it = retired_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    std::atomic<T*> current_;
+    std::atomic<uint64_t> generation_{0};
+    std::atomic<uint64_t> reader_generation_{0};
+
+    std::mutex writer_mutex_;
+    std::vector<Retired> retired_;
+};
@@ -0,0 +1,33 @@
+#include "stats.h"
+
+#include <cstdio>
+
+PipelineStats pipeline_stats;
+
+const StatsEntry PIPELINE_STATS_ENTRIES[] = {
+    {"wakeup", &pipeline_stats.wakeup},
+    {"dispatch", &pipeline_stats.dispatch},
+    {"recognition", &pipeline_stats.recognition},
+    {"spawn", &pipeline_stats.spawn},
+    {"gui_frame", &pipeline_stats.gui_frame},
+};
+
+const size_t PIPELINE_STATS_ENTRY_COUNT = sizeof(PIPELINE_STATS_ENTRIES) / sizeof(PIPELINE_STATS_ENTRIES[0]);
+
+void dump_pipeline_stats(std::ostream &out)
+{
+    char line[128];
+    std::snprintf(line, sizeof(line), "%-12s %10s %10s %10s %10s %10s  (us)\n",
+                  "stage", "count", "p50", "p90", "p99", "max");
+    out << line;
+
+    for (size_t i = 0; i < PIPELINE_STATS_ENTRY_COUNT; ++i)
+    {
+        LatencyHistogram::Summary s = PIPELINE_STATS_ENTRIES[i].histogram->summary();
+        std::snprintf(line, sizeof(line), "%-12s %10llu %10.1f %10.1f %10.1f %10.1f\n",
+                      PIPELINE_STATS_ENTRIES[i].name, (unsigned long long)s.count,
+                      s.p50 / 1000.0, s.p90 / 1000.0, s.p99 / 1000.0, s.max / 1000.0);
+        out << line;
+    }
+    out.flush();
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+
+#include "histogram.h"
+
+// Latency histograms for the gesture pipeline, in nanoseconds. Each is
+// recorded by the thread that owns that stage.
+struct PipelineStats {
+    LatencyHistogram wakeup;        // event timestamp -> the input thread handling it
+    LatencyHistogram dispatch;      // libinput_dispatch plus handling the batch it yields
+    LatencyHistogram recognition;   // gesture timestamp -> command handed to the executor
+    LatencyHistogram spawn;         // gesture timestamp -> posix_spawn returned or action sent
+    LatencyHistogram gui_frame;     // building and rendering one GUI frame
+};
+
+extern PipelineStats pipeline_stats;
+
+struct StatsEntry {
+    const char *name;
+    const LatencyHistogram *histogram;
+};
+
+extern const StatsEntry PIPELINE_STATS_ENTRIES[];
+extern const size_t PIPELINE_STATS_ENTRY_COUNT;
+
+// Plain-text table of every histogram, in microseconds
+void dump_pipeline_stats(std::ostream &out);
@@ -0,0 +1,156 @@
+#include "stream_sink.h"
+
+#include "log.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+static const uint64_t RETRY_NS = 1000000000ull;
+
+// Back-off when the consumer isn't reading, so an unlimited rate doesn't spin
+static const uint64_t BACKPRESSURE_NS = 1000000ull;
+
+StreamSink::StreamSink(std::string target)
+    : target_(std::move(target))
+{
+}
+
+StreamSink::~StreamSink()
+{
+    hang_up();
+}
+
+void StreamSink::open_failed(uint64_t now_ns)
+{
+    retry_at_ns_ = now_ns + RETRY_NS;
+}
+
+bool StreamSink::connect_socket(uint64_t now_ns)
+{
+    std::string path = target_.substr(5);
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path))
+    {
+        LOG(Error) << "Invalid stream socket path: " << path;
+        open_failed(now_ns);
+        return false;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        LOG(Error) << "Failed to connect stream socket " << path << ": " << std::strerror(errno);
+        if (fd >= 0)
+            close(fd);
+        open_failed(now_ns);
+        return false;
+    }
+
+    attach(fd);
+    return true;
+}
+
+void StreamSink::attach(int fd)
+{
+    hang_up();
+    fd_ = fd;
+}
+
+void StreamSink::hang_up()
+{
+    if (fd_ >= 0)
+    {
+        close(fd_);
+        fd_ = -1;
+    }
+    pending_ = 0;
+    unsent_length_ = 0;
+}
+
+void StreamSink::add(GestureKey key, int steps, int rate, uint64_t now_ns)
+{
+    // Steps only coalesce within one gesture; if the consumer can't take
+    // the previous gesture's remainder right now it is lost
+    if (pending_ != 0 && key != key_)
+    {
+        write_pending(now_ns);
+        pending_ = 0;
+    }
+
+    key_ = key;
+    pending_ += steps;
+    interval_ns_ = rate > 0 ? 1000000000ull / (uint64_t)rate : 0;
+}
+
+void StreamSink::flush(uint64_t now_ns)
+{
+    if (due_in_ns(now_ns) == 0)
+        write_pending(now_ns);
+}
+
+int64_t StreamSink::due_in_ns(uint64_t now_ns) const
+{
+    if ((pending_ == 0 && unsent_length_ == 0) || fd_ < 0)
+        return -1;
+    uint64_t due = std::max(last_write_ns_ + interval_ns_, blocked_until_ns_);
+    return due > now_ns ? (int64_t)(due - now_ns) : 0;
+}
+
+void StreamSink::write_pending(uint64_t now_ns)
+{
+    // A consumer only ever sees whole lines, so a partial one is finished
+    // before the next; meanwhile steps keep coalescing into pending_
+    if (unsent_length_ > 0)
+    {
+        ssize_t written = send_some(unsent_, unsent_length_, now_ns);
+        if (written < 0)
+            return;
+        unsent_length_ -= (size_t)written;
+        std::memmove(unsent_, unsent_ + written, unsent_length_);
+        if (unsent_length_ > 0)
+            return;
+    }
+    if (pending_ == 0)
+        return;
+
+    char line[sizeof(unsent_)];
+    int length = std::snprintf(line, sizeof(line), "%s %d %s %d\n",
+                               gesture_kind_name(gesture_kind(key_)), gesture_fingers(key_),
+                               gesture_variant_name(key_), pending_);
+    ssize_t written = send_some(line, (size_t)length, now_ns);
+    if (written <= 0)
+        return;
+    pending_ = 0;
+    unsent_length_ = (size_t)length - (size_t)written;
+    std::memcpy(unsent_, line + written, unsent_length_);
+}
+
+// How much of data was written, or -1 after hanging up. After a short write
+// (or none at all, when the socket is full) the rest is retried once the
+// back-off has passed.
+ssize_t StreamSink::send_some(const char *data, size_t length, uint64_t now_ns)
+{
+    ssize_t written = send(fd_, data, length, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        written = 0;
+    if (written < 0)
+    {
+        LOG(Warn) << "Stream to " << target_ << " closed: " << std::strerror(errno);
+        hang_up();
+        return -1;
+    }
+
+    if ((size_t)written < length)
+        blocked_until_ns_ = now_ns + BACKPRESSURE_NS;
+    else
+        last_write_ns_ = now_ns;
+    return written;
+}
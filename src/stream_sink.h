@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <sys/types.h>
+
+#include "gesture.h"
+
+// Coalescing writer for one streaming target, owned by the executor thread.
+//
+// Steps are summed per gesture and written at most once per rate interval
+// as "<kind> <fingers> <DIR> <steps>\n", e.g. "swipe 3 UP -2". A target of
+// "unix:PATH" connects to a stream socket someone else listens on; anything
+// else is a command the executor keeps running and attaches here by its
+// stdin.
+class StreamSink {
+public:
+    explicit StreamSink(std::string target);
+    ~StreamSink();
+
+    StreamSink(const StreamSink &) = delete;
+    StreamSink &operator=(const StreamSink &) = delete;
+
+    const std::string &target() const { return target_; }
+    bool is_socket() const { return target_.compare(0, 5, "unix:") == 0; }
+
+    int fd() const { return fd_; }
+    bool connected() const { return fd_ >= 0; }
+
+    // Opening is retried at most once per second after a failure
+    bool retry_due(uint64_t now_ns) const { return now_ns >= retry_at_ns_; }
+    void open_failed(uint64_t now_ns);
+
+    // Connects a "unix:" target
+    bool connect_socket(uint64_t now_ns);
+
+    // Takes ownership of an already connected descriptor
+    void attach(int fd);
+
+    // Closes the connection and forgets whatever was pending, including the
+    // rest of a line that was only partly written
+    void hang_up();
+
+    void add(GestureKey key, int steps, int rate, uint64_t now_ns);
+
+    // Writes the pending steps if the rate allows
+    void flush(uint64_t now_ns);
+
+    // Nanoseconds until flush() has something to write, or -1 if nothing
+    // is pending
+    int64_t due_in_ns(uint64_t now_ns) const;
+
+private:
+    void write_pending(uint64_t now_ns);
+    ssize_t send_some(const char *data, size_t length, uint64_t now_ns);
+
+    std::string target_;
+    int fd_ = -1;
+    uint64_t retry_at_ns_ = 0;
+
+    GestureKey key_ = 0;
+    int pending_ = 0;
+    uint64_t interval_ns_ = 0;
+    uint64_t last_write_ns_ = 0;
+    uint64_t blocked_until_ns_ = 0;
+
+    // What a short write left of the last line; sent before anything else
+    char unsent_[64];
+    size_t unsent_length_ = 0;
+};
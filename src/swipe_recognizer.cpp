@@ -0,0 +1,138 @@
+#include "swipe_recognizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Share of the motion that must be along the bound direction to fire early
+static const double EARLY_MIN_STRAIGHTNESS = 0.75;
+
+// Motion, in millimetres, before a streaming binding takes the swipe over,
+// so the direction isn't picked from the first noisy update
+static const double STREAM_LOCK_DISTANCE = 1.0;
+
+// Finest step a binding can ask for
+static const double MIN_STREAM_STEP_MM = 0.1;
+
+void SwipeRecognizer::begin(int fingers, GestureKind kind, double threshold)
+{
+    *this = SwipeRecognizer();
+    kind_ = kind;
+    fingers_ = fingers;
+    threshold_ = threshold;
+    active_ = true;
+}
+
+bool SwipeRecognizer::update(double dx, double dy, const BindingTable &bindings, GestureKey &key)
+{
+    dx_ += dx;
+    dy_ += dy;
+    min_x_ = std::min(min_x_, dx_);
+    max_x_ = std::max(max_x_, dx_);
+    min_y_ = std::min(min_y_, dy_);
+    max_y_ = std::max(max_y_, dy_);
+
+    if (fired_ || streaming_ || !gesture_fingers_valid(fingers_))
+        return false;
+
+    // Only the currently dominant direction can fire
+    Direction dir;
+    if (!classify_swipe(dx_, dy_, 0.0, dir))
+        return false;
+
+    GestureKey candidate = make_gesture_key(kind_, fingers_, dir);
+    const CommandRef &command = bindings[candidate];
+    if (!command)
+        return false;
+
+    if (command->options.stream)
+    {
+        if (travel(dir) >= STREAM_LOCK_DISTANCE)
+        {
+            streaming_ = true;
+            stream_key_ = candidate;
+            double step = command->options.stream_step > 0.0 ? command->options.stream_step : STREAM_STEP_MM;
+            stream_step_ = std::max(step, MIN_STREAM_STEP_MM);
+        }
+        return false;
+    }
+
+    if (command->options.early_distance <= 0.0)
+        return false;
+
+    double along = travel(dir);
+    double across = (dir == Direction::Left || dir == Direction::Right) ? std::abs(dy_) : std::abs(dx_);
+    if (along < command->options.early_distance || along < EARLY_MIN_STRAIGHTNESS * (along + across))
+        return false;
+
+    fired_ = true;
+    key = candidate;
+    return true;
+}
+
+bool SwipeRecognizer::end(bool cancelled, const BindingTable &bindings, GestureKey &key)
+{
+    active_ = false;
+    if (cancelled || fired_ || streaming_ || !gesture_fingers_valid(fingers_))
+        return false;
+
+    Direction dir;
+    if (!classify_swipe(dx_, dy_, threshold_, dir))
+    {
+        if (dx_ == 0.0 && dy_ == 0.0)
+            return false;
+        if (std::abs(dx_) > std::abs(dy_))
+            dir = dx_ > 0.0 ? Direction::Right : Direction::Left;
+        else
+            dir = dy_ > 0.0 ? Direction::Down : Direction::Up;
+        key = make_gesture_key(kind_, fingers_, dir);
+        fell_short_ = true;
+        return false;
+    }
+
+    key = make_gesture_key(kind_, fingers_, dir);
+    const CommandRef &command = bindings[key];
+    if (command && command->options.cancel_if_reversed && peak(dir) - travel(dir) > threshold_)
+    {
+        cancelled_ = true;
+        return false;
+    }
+    return true;
+}
+
+int SwipeRecognizer::take_stream_steps()
+{
+    if (!streaming_)
+        return 0;
+
+    // Quantise the total rather than each update so rounding doesn't drift
+    int total = (int)(travel(gesture_direction(stream_key_)) / stream_step_);
+    int steps = total - streamed_steps_;
+    streamed_steps_ = total;
+    return steps;
+}
+
+// Signed displacement along dir
+double SwipeRecognizer::travel(Direction dir) const
+{
+    switch (dir)
+    {
+    case Direction::Left:  return -dx_;
+    case Direction::Right: return dx_;
+    case Direction::Up:    return -dy_;
+    case Direction::Down:  return dy_;
+    }
+    return 0.0;
+}
+
+// Furthest displacement along dir at any point during the swipe
+double SwipeRecognizer::peak(Direction dir) const
+{
+    switch (dir)
+    {
+    case Direction::Left:  return -min_x_;
+    case Direction::Right: return max_x_;
+    case Direction::Up:    return -min_y_;
+    case Direction::Down:  return max_y_;
+    }
+    return 0.0;
+}
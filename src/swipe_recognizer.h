@@ -0,0 +1,72 @@
+#pragma once
+
+#include "bindings.h"
+#include "gesture.h"
+
+// Incremental swipe classifier, evaluated on every SWIPE_UPDATE. Two-finger
+// scrolling goes through the same classifier as GestureKind::Scroll.
+//
+// A binding with an early distance fires mid-swipe, as soon as the motion
+// is that far along its direction and mostly straight; the swipe is then
+// done and SWIPE_END dispatches nothing. Every other binding is resolved at
+// SWIPE_END from the total motion, as before.
+//
+// A streaming binding takes over the swipe once it has moved a little way
+// in the bound direction; from then on the signed motion along that axis is
+// quantised into steps for take_stream_steps() and nothing fires.
+//
+// Motion is in millimetres; threshold is how far a swipe must go to count.
+class SwipeRecognizer {
+public:
+    void begin(int fingers, GestureKind kind = GestureKind::Swipe, double threshold = SWIPE_THRESHOLD_MM);
+
+    // Accumulates one update. Returns true, at most once per swipe, when an
+    // early binding should fire now; key is set to it.
+    bool update(double dx, double dy, const BindingTable &bindings, GestureKey &key);
+
+    // Returns true if the finished swipe should be dispatched; key is set to
+    // the recognised gesture, which may be unbound. A swipe that moved but
+    // not as far as the threshold sets fell_short() and key to the way it
+    // went furthest. One libinput cancelled is dropped without either.
+    bool end(bool cancelled, const BindingTable &bindings, GestureKey &key);
+
+    bool active() const { return active_; }
+    bool fired_early() const { return fired_; }
+    bool cancelled() const { return cancelled_; }
+    bool fell_short() const { return fell_short_; }
+
+    bool streaming() const { return streaming_; }
+    GestureKey stream_key() const { return stream_key_; }
+
+    // Whole steps moved along the streamed direction since the last call;
+    // negative when moving back
+    int take_stream_steps();
+
+    int fingers() const { return fingers_; }
+    double dx() const { return dx_; }
+    double dy() const { return dy_; }
+
+private:
+    double travel(Direction dir) const;
+    double peak(Direction dir) const;
+
+    GestureKind kind_ = GestureKind::Swipe;
+    int fingers_ = 0;
+    double threshold_ = SWIPE_THRESHOLD_MM;
+    double dx_ = 0.0;
+    double dy_ = 0.0;
+
+    // Furthest extent reached along each axis
+    double min_x_ = 0.0, max_x_ = 0.0;
+    double min_y_ = 0.0, max_y_ = 0.0;
+
+    bool active_ = false;
+    bool fired_ = false;
+    bool cancelled_ = false;
+    bool fell_short_ = false;
+
+    bool streaming_ = false;
+    GestureKey stream_key_ = 0;
+    double stream_step_ = 0.0;
+    int streamed_steps_ = 0;
+};
@@ -0,0 +1,201 @@
+#include "thread_priority.h"
+
+#include "log.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#ifdef HAVE_DBUS
+#include <dbus/dbus.h>
+#endif
+
+// rtkit only hands out realtime scheduling to a process whose RLIMIT_RTTIME
+// is at most this, so a runaway thread is killed rather than locking up the
+// desktop. The input thread blocks in epoll between batches, well within it.
+static const rlim_t RTTIME_LIMIT_US = 200000;
+
+static pid_t thread_id()
+{
+    return (pid_t)syscall(SYS_gettid);
+}
+
+#ifdef HAVE_DBUS
+
+// How long to wait for rtkit to answer
+static const int RTKIT_TIMEOUT_MS = 1000;
+
+// Calls an org.freedesktop.RealtimeKit1 method taking the thread id and one
+// int32 or uint32 argument; false, after logging why, if rtkit refuses
+static bool call_rtkit(const char *method, int type, const void *value)
+{
+    DBusError error;
+    dbus_error_init(&error);
+    DBusConnection *connection = dbus_bus_get_private(DBUS_BUS_SYSTEM, &error);
+    if (!connection)
+    {
+        LOG(Warn) << "Failed to connect to the system bus for rtkit: " << error.message;
+        dbus_error_free(&error);
+        return false;
+    }
+    dbus_connection_set_exit_on_disconnect(connection, FALSE);
+
+    DBusMessage *message = dbus_message_new_method_call("org.freedesktop.RealtimeKit1", "/org/freedesktop/RealtimeKit1",
+                                                        "org.freedesktop.RealtimeKit1", method);
+    dbus_uint64_t thread = (dbus_uint64_t)thread_id();
+    DBusMessageIter iter;
+    dbus_message_iter_init_append(message, &iter);
+    dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT64, &thread);
+    dbus_message_iter_append_basic(&iter, type, value);
+
+    DBusMessage *reply = dbus_connection_send_with_reply_and_block(connection, message, RTKIT_TIMEOUT_MS, &error);
+    dbus_message_unref(message);
+    bool ok = reply != nullptr;
+    if (reply)
+        dbus_message_unref(reply);
+    else
+    {
+        LOG(Warn) << "rtkit refused " << method << ": " << error.message;
+        dbus_error_free(&error);
+    }
+
+    dbus_connection_close(connection);
+    dbus_connection_unref(connection);
+    return ok;
+}
+
+static bool rtkit_realtime(int priority)
+{
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_RTTIME, &limit) == 0 && (limit.rlim_max == RLIM_INFINITY || limit.rlim_max > RTTIME_LIMIT_US))
+    {
+        limit.rlim_cur = limit.rlim_max = RTTIME_LIMIT_US;
+        if (setrlimit(RLIMIT_RTTIME, &limit) != 0)
+            LOG(Warn) << "Failed to set RLIMIT_RTTIME: " << std::strerror(errno);
+    }
+
+    dbus_uint32_t value = (dbus_uint32_t)priority;
+    return call_rtkit("MakeThreadRealtime", DBUS_TYPE_UINT32, &value);
+}
+
+static bool rtkit_nice(int nice)
+{
+    dbus_int32_t value = nice;
+    return call_rtkit("MakeThreadHighPriority", DBUS_TYPE_INT32, &value);
+}
+
+#else
+
+static bool rtkit_realtime(int)
+{
+    return false;
+}
+
+static bool rtkit_nice(int)
+{
+    return false;
+}
+
+#endif
+
+static void set_realtime(int priority)
+{
+    // Children never inherit it, whichever thread ends up spawning them
+    struct sched_param param = {};
+    param.sched_priority = priority;
+    if (sched_setscheduler(0, SCHED_FIFO | SCHED_RESET_ON_FORK, &param) == 0)
+        return;
+
+    int error = errno;
+    if (error != EPERM || !rtkit_realtime(priority))
+        LOG(Warn) << "Failed to set SCHED_FIFO priority " << priority << ": " << std::strerror(error);
+}
+
+static void set_nice(int nice)
+{
+    // PRIO_PROCESS with a thread id sets just that thread on Linux
+    if (setpriority(PRIO_PROCESS, (id_t)thread_id(), nice) == 0)
+        return;
+
+    int error = errno;
+    if ((error != EACCES && error != EPERM) || !rtkit_nice(nice))
+        LOG(Warn) << "Failed to set nice " << nice << ": " << std::strerror(error);
+}
+
+static void set_cpu(int cpu)
+{
+    if (cpu >= CPU_SETSIZE)
+    {
+        LOG(Warn) << "Cannot pin to CPU " << cpu << ": out of range";
+        return;
+    }
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    int error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if (error != 0)
+        LOG(Warn) << "Failed to pin to CPU " << cpu << ": " << std::strerror(error);
+}
+
+void apply_thread_scheduling(const SchedulingOptions &options)
+{
+    if (options.realtime_priority > 0)
+        set_realtime(options.realtime_priority);
+    else if (options.nice != 0)
+        set_nice(options.nice);
+    if (options.cpu >= 0)
+        set_cpu(options.cpu);
+
+    bool changed = options.realtime_priority > 0 || options.nice != 0 || options.cpu >= 0;
+    if (!changed || !log_enabled(LogLevel::Info))
+        return;
+
+    // What we ended up with, which rtkit may have set for us
+    LogLine line(LogLevel::Info);
+    line << "Input thread scheduling: ";
+    struct sched_param param = {};
+    int policy = sched_getscheduler(0) & ~SCHED_RESET_ON_FORK;
+    if (policy == SCHED_FIFO && sched_getparam(0, &param) == 0)
+        line << "SCHED_FIFO priority " << param.sched_priority;
+    else
+        line << "nice " << getpriority(PRIO_PROCESS, (id_t)thread_id());
+
+    cpu_set_t cpus;
+    if (options.cpu >= 0 && pthread_getaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0 && CPU_COUNT(&cpus) == 1)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (CPU_ISSET(cpu, &cpus))
+                line << ", CPU " << cpu;
+        }
+    }
+}
+
+bool lock_memory()
+{
+    int flags = MCL_CURRENT | MCL_FUTURE;
+#ifdef MCL_ONFAULT
+    // Kernels before 4.4 reject MCL_ONFAULT with EINVAL
+    if (mlockall(flags | MCL_ONFAULT) == 0)
+        return true;
+    if (errno != EINVAL)
+    {
+        LOG(Warn) << "Failed to lock memory: " << std::strerror(errno);
+        return false;
+    }
+#endif
+    if (mlockall(flags) != 0)
+    {
+        LOG(Warn) << "Failed to lock memory: " << std::strerror(errno);
+        return false;
+    }
+    return true;
+}
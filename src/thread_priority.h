@@ -0,0 +1,23 @@
+#pragma once
+
+// How the input thread is scheduled, so gestures keep up when the desktop is
+// busy compiling. Everything defaults to leaving the scheduler alone.
+struct SchedulingOptions {
+    int realtime_priority = 0;  // SCHED_FIFO priority, 1-99; 0 keeps SCHED_OTHER
+    int nice = 0;               // for SCHED_OTHER, e.g. -10
+    int cpu = -1;               // pin to this CPU; -1 leaves it free to move
+    bool lock_memory = false;   // see lock_memory()
+};
+
+// Applies the options to the calling thread only, so threads it doesn't
+// start (the GUI, the executor) stay at normal priority. Without the
+// privilege to do it directly, realtime and negative nice values are asked
+// of rtkit over the system bus, when built with HAVE_DBUS. Failures are
+// logged and leave that setting as it was.
+void apply_thread_scheduling(const SchedulingOptions &options);
+
+// mlockall() for the whole process, current and future mappings, so a busy
+// system can't page out what the input thread touches. Pages are locked as
+// they fault in where the kernel supports it, rather than all up front.
+// False, after logging why, if the memlock limit or permissions refuse it.
+bool lock_memory();
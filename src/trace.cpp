@@ -0,0 +1,145 @@
+#include "trace.h"
+
+#include "log.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+static const char TRACE_MAGIC[8] = {'G', 'S', 'T', 'T', 'R', 'A', 'C', 'E'};
+// Motion in millimetres; version 1 traces, in accelerated libinput units,
+// are refused
+static const uint32_t TRACE_VERSION = 2;
+
+struct TraceHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+};
+
+// Records buffered between writes
+static const size_t TRACE_BUFFER_EVENTS = 4096;
+
+static bool write_all(int fd, const void *data, size_t size)
+{
+    const char *bytes = (const char *)data;
+    while (size > 0)
+    {
+        ssize_t written = write(fd, bytes, size);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        bytes += written;
+        size -= (size_t)written;
+    }
+    return true;
+}
+
+TraceWriter::~TraceWriter()
+{
+    close();
+}
+
+bool TraceWriter::open(const std::string &path)
+{
+    close();
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0)
+    {
+        LOG(Error) << "Failed to create trace " << path << ": " << std::strerror(errno);
+        return false;
+    }
+
+    TraceHeader header = {};
+    std::memcpy(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    header.version = TRACE_VERSION;
+    header.record_size = sizeof(TraceEvent);
+    if (!write_all(fd_, &header, sizeof(header)))
+    {
+        LOG(Error) << "Failed to write trace " << path << ": " << std::strerror(errno);
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+
+    buffer_.resize(TRACE_BUFFER_EVENTS);
+    used_ = 0;
+    count_ = 0;
+    return true;
+}
+
+void TraceWriter::close()
+{
+    if (fd_ < 0)
+        return;
+    flush();
+    ::close(fd_);
+    fd_ = -1;
+}
+
+void TraceWriter::append(const TraceEvent &event)
+{
+    if (fd_ < 0)
+        return;
+    buffer_[used_++] = event;
+    count_++;
+    if (used_ == buffer_.size())
+        flush();
+}
+
+void TraceWriter::flush()
+{
+    if (fd_ < 0 || used_ == 0)
+        return;
+    if (!write_all(fd_, buffer_.data(), used_ * sizeof(TraceEvent)))
+        LOG(Error) << "Failed to write trace: " << std::strerror(errno);
+    used_ = 0;
+}
+
+bool load_trace(const std::string &path, std::vector<TraceEvent> &events)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        LOG(Error) << "Failed to open trace " << path << ": " << std::strerror(errno);
+        return false;
+    }
+
+    struct stat st;
+    TraceHeader header;
+    bool ok = fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(header) &&
+              read(fd, &header, sizeof(header)) == (ssize_t)sizeof(header) &&
+              std::memcmp(header.magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) == 0 &&
+              header.version == TRACE_VERSION && header.record_size == sizeof(TraceEvent) &&
+              (st.st_size - sizeof(header)) % sizeof(TraceEvent) == 0;
+
+    if (ok)
+    {
+        size_t count = (st.st_size - sizeof(header)) / sizeof(TraceEvent);
+        events.resize(count);
+        size_t size = count * sizeof(TraceEvent);
+        char *data = (char *)events.data();
+        size_t done = 0;
+        while (ok && done < size)
+        {
+            ssize_t got = read(fd, data + done, size - done);
+            if (got < 0 && errno == EINTR)
+                continue;
+            ok = got > 0;
+            if (ok)
+                done += (size_t)got;
+        }
+    }
+    ::close(fd);
+
+    if (!ok)
+    {
+        LOG(Error) << "Invalid trace: " << path;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The parts of a libinput event the recognisers consume. The input thread
+// translates every event it handles into one of these, so the same gesture
+// state machines can be driven from a recorded trace without a touchpad.
+enum class TraceEventType : uint8_t {
+    DeviceAdded = 0,
+    DeviceRemoved,
+    SwipeBegin,
+    SwipeUpdate,
+    SwipeEnd,
+    PinchBegin,
+    PinchUpdate,
+    PinchEnd,
+    HoldBegin,
+    HoldEnd,
+    Scroll,
+};
+
+enum TraceEventFlags : uint8_t {
+    TRACE_CANCELLED = 1 << 0,     // gesture end reported as cancelled
+    TRACE_SCROLL_V = 1 << 1,      // scroll event has a vertical value (dy)
+    TRACE_SCROLL_H = 1 << 2,      // scroll event has a horizontal value (dx)
+    TRACE_SCROLL_FINGER = 1 << 3, // scroll came from fingers, not a wheel
+};
+
+// Also the on-disk record, so keep it 24 bytes with no padding. DeviceAdded
+// carries the touchpad's width and height in mm in dx and dy (0 if unknown).
+struct TraceEvent {
+    uint64_t time_us;
+    TraceEventType type;
+    uint8_t fingers;
+    uint8_t flags;
+    uint8_t device;     // index the recording daemon gave the device
+    float dx;           // swipe/pinch motion in mm or horizontal scroll
+    float dy;           // or vertical scroll
+    float scale;        // pinch scale relative to PINCH_BEGIN
+};
+
+static_assert(sizeof(TraceEvent) == 24, "trace records are written raw");
+
+// Appends events to a trace file. Events are buffered in a block allocated
+// up front, so append() neither allocates nor, until the block fills,
+// makes a system call. The input thread also flushes it once a second,
+// and close() writes out the rest.
+class TraceWriter {
+public:
+    TraceWriter() = default;
+    ~TraceWriter();
+
+    TraceWriter(const TraceWriter &) = delete;
+    TraceWriter &operator=(const TraceWriter &) = delete;
+
+    bool open(const std::string &path);
+    void close();
+
+    void append(const TraceEvent &event);
+    void flush();
+
+    uint64_t count() const { return count_; }
+
+private:
+    int fd_ = -1;
+    std::vector<TraceEvent> buffer_;
+    size_t used_ = 0;
+    uint64_t count_ = 0;
+};
+
+// Loads a whole trace into memory. Only the current version, with motion in
+// millimetres, loads; anything else is rejected as invalid.
+bool load_trace(const std::string &path, std::vector<TraceEvent> &events);
@@ -0,0 +1,192 @@
+#include "uinput_keyboard.h"
+
+#include "clock.h"
+#include "log.h"
+
+#include <fcntl.h>
+#include <linux/uinput.h>
+#include <strings.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+// How long a new device takes to be picked up, by udev and then the display
+// server, before its keys get through
+static const uint64_t SETTLE_NS = 200000000ull;
+
+struct KeyName {
+    const char *name;
+    int code;
+};
+
+static const KeyName KEY_NAMES[] = {
+    // Modifiers
+    {"ctrl", KEY_LEFTCTRL}, {"control", KEY_LEFTCTRL}, {"shift", KEY_LEFTSHIFT},
+    {"alt", KEY_LEFTALT}, {"altgr", KEY_RIGHTALT}, {"super", KEY_LEFTMETA}, {"meta", KEY_LEFTMETA},
+
+    // Letters and digits
+    {"a", KEY_A}, {"b", KEY_B}, {"c", KEY_C}, {"d", KEY_D}, {"e", KEY_E}, {"f", KEY_F},
+    {"g", KEY_G}, {"h", KEY_H}, {"i", KEY_I}, {"j", KEY_J}, {"k", KEY_K}, {"l", KEY_L},
+    {"m", KEY_M}, {"n", KEY_N}, {"o", KEY_O}, {"p", KEY_P}, {"q", KEY_Q}, {"r", KEY_R},
+    {"s", KEY_S}, {"t", KEY_T}, {"u", KEY_U}, {"v", KEY_V}, {"w", KEY_W}, {"x", KEY_X},
+    {"y", KEY_Y}, {"z", KEY_Z},
+    {"0", KEY_0}, {"1", KEY_1}, {"2", KEY_2}, {"3", KEY_3}, {"4", KEY_4},
+    {"5", KEY_5}, {"6", KEY_6}, {"7", KEY_7}, {"8", KEY_8}, {"9", KEY_9},
+
+    // Function keys
+    {"F1", KEY_F1}, {"F2", KEY_F2}, {"F3", KEY_F3}, {"F4", KEY_F4}, {"F5", KEY_F5}, {"F6", KEY_F6},
+    {"F7", KEY_F7}, {"F8", KEY_F8}, {"F9", KEY_F9}, {"F10", KEY_F10}, {"F11", KEY_F11}, {"F12", KEY_F12},
+
+    // Navigation and editing
+    {"Left", KEY_LEFT}, {"Right", KEY_RIGHT}, {"Up", KEY_UP}, {"Down", KEY_DOWN},
+    {"Page_Up", KEY_PAGEUP}, {"Prior", KEY_PAGEUP}, {"Page_Down", KEY_PAGEDOWN}, {"Next", KEY_PAGEDOWN},
+    {"Home", KEY_HOME}, {"End", KEY_END}, {"Insert", KEY_INSERT}, {"Delete", KEY_DELETE},
+    {"BackSpace", KEY_BACKSPACE}, {"Tab", KEY_TAB}, {"Return", KEY_ENTER}, {"Enter", KEY_ENTER},
+    {"Escape", KEY_ESC}, {"Esc", KEY_ESC}, {"space", KEY_SPACE}, {"Print", KEY_SYSRQ},
+
+    // Punctuation
+    {"minus", KEY_MINUS}, {"equal", KEY_EQUAL}, {"plus", KEY_KPPLUS}, {"comma", KEY_COMMA},
+    {"period", KEY_DOT}, {"slash", KEY_SLASH}, {"backslash", KEY_BACKSLASH}, {"semicolon", KEY_SEMICOLON},
+    {"apostrophe", KEY_APOSTROPHE}, {"grave", KEY_GRAVE}, {"bracketleft", KEY_LEFTBRACE},
+    {"bracketright", KEY_RIGHTBRACE},
+
+    // Media and hardware keys
+    {"XF86AudioPlay", KEY_PLAYPAUSE}, {"XF86AudioPause", KEY_PAUSECD}, {"XF86AudioStop", KEY_STOPCD},
+    {"XF86AudioNext", KEY_NEXTSONG}, {"XF86AudioPrev", KEY_PREVIOUSSONG},
+    {"XF86AudioRaiseVolume", KEY_VOLUMEUP}, {"XF86AudioLowerVolume", KEY_VOLUMEDOWN},
+    {"XF86AudioMute", KEY_MUTE}, {"XF86MonBrightnessUp", KEY_BRIGHTNESSUP},
+    {"XF86MonBrightnessDown", KEY_BRIGHTNESSDOWN},
+};
+
+static bool find_key(const std::string &name, int &code)
+{
+    for (const KeyName &key : KEY_NAMES)
+    {
+        if (strcasecmp(name.c_str(), key.name) == 0)
+        {
+            code = key.code;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parse_key_combos(const std::string &text, std::vector<KeyCombo> &combos)
+{
+    combos.clear();
+    size_t start = 0;
+    while (start < text.size())
+    {
+        size_t end = text.find(' ', start);
+        if (end == std::string::npos)
+            end = text.size();
+        if (end == start)
+        {
+            ++start;
+            continue;
+        }
+
+        KeyCombo combo;
+        std::string combo_text = text.substr(start, end - start);
+        size_t key_start = 0;
+        while (key_start <= combo_text.size())
+        {
+            size_t key_end = combo_text.find('+', key_start);
+            if (key_end == std::string::npos)
+                key_end = combo_text.size();
+            int code;
+            if (!find_key(combo_text.substr(key_start, key_end - key_start), code))
+                return false;
+            combo.push_back(code);
+            key_start = key_end + 1;
+        }
+        combos.push_back(std::move(combo));
+        start = end + 1;
+    }
+    return !combos.empty();
+}
+
+UinputKeyboard::~UinputKeyboard()
+{
+    if (fd_ >= 0)
+    {
+        ioctl(fd_, UI_DEV_DESTROY);
+        close(fd_);
+    }
+}
+
+bool UinputKeyboard::open()
+{
+    if (fd_ >= 0)
+        return true;
+
+    int fd = ::open("/dev/uinput", O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+    {
+        if (!warned_)
+            LOG(Warn) << "Failed to open /dev/uinput, key actions are disabled: " << std::strerror(errno);
+        warned_ = true;
+        return false;
+    }
+
+    bool ok = ioctl(fd, UI_SET_EVBIT, EV_KEY) == 0;
+    for (const KeyName &key : KEY_NAMES)
+        ok = ok && ioctl(fd, UI_SET_KEYBIT, key.code) == 0;
+
+    struct uinput_setup setup = {};
+    setup.id.bustype = BUS_VIRTUAL;
+    std::strncpy(setup.name, "gesture-daemon keyboard", UINPUT_MAX_NAME_SIZE - 1);
+    ok = ok && ioctl(fd, UI_DEV_SETUP, &setup) == 0 && ioctl(fd, UI_DEV_CREATE) == 0;
+    if (!ok)
+    {
+        if (!warned_)
+            LOG(Warn) << "Failed to create uinput keyboard, key actions are disabled: " << std::strerror(errno);
+        warned_ = true;
+        close(fd);
+        return false;
+    }
+
+    fd_ = fd;
+    created_ns_ = monotonic_ns();
+    return true;
+}
+
+bool UinputKeyboard::emit(int type, int code, int value)
+{
+    struct input_event event = {};
+    event.type = (unsigned short)type;
+    event.code = (unsigned short)code;
+    event.value = value;
+    return write(fd_, &event, sizeof(event)) == (ssize_t)sizeof(event);
+}
+
+bool UinputKeyboard::press(const std::vector<KeyCombo> &combos)
+{
+    if (!open())
+        return false;
+
+    // Only ever right after the device was created
+    uint64_t age = monotonic_ns() - created_ns_;
+    if (age < SETTLE_NS)
+    {
+        struct timespec wait = {0, (long)(SETTLE_NS - age)};
+        nanosleep(&wait, nullptr);
+    }
+
+    bool ok = true;
+    for (const KeyCombo &combo : combos)
+    {
+        for (int code : combo)
+            ok &= emit(EV_KEY, code, 1);
+        ok &= emit(EV_SYN, SYN_REPORT, 0);
+        for (size_t i = combo.size(); i-- > 0;)
+            ok &= emit(EV_KEY, combo[i], 0);
+        ok &= emit(EV_SYN, SYN_REPORT, 0);
+    }
+    if (!ok)
+        LOG(Error) << "Failed to write key events: " << std::strerror(errno);
+    return ok;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A key combination, e.g. ctrl+alt+Left, as Linux input key codes pressed in
+// order and released in reverse
+using KeyCombo = std::vector<int>;
+
+// Parses space-separated combos such as "ctrl+c ctrl+v" or "super+Page_Up".
+// Key names are matched case-insensitively against the usual X keysym-like
+// names. Returns false on an unknown name.
+bool parse_key_combos(const std::string &text, std::vector<KeyCombo> &combos);
+
+// Virtual keyboard on /dev/uinput for key actions. The device is created
+// up front and then held open, so keystrokes are a few write()s. A new
+// device takes a moment to be picked up by the display server, and keys sent
+// before then are dropped, so press() waits that out on a fresh device.
+class UinputKeyboard {
+public:
+    UinputKeyboard() = default;
+    ~UinputKeyboard();
+
+    UinputKeyboard(const UinputKeyboard &) = delete;
+    UinputKeyboard &operator=(const UinputKeyboard &) = delete;
+
+    // Creates the device. Failing only disables key actions, so it is logged
+    // the first time and press() tries again.
+    bool open();
+
+    bool press(const std::vector<KeyCombo> &combos);
+
+private:
+    bool emit(int type, int code, int value);
+
+    int fd_ = -1;
+    uint64_t created_ns_ = 0;
+    bool warned_ = false;
+};